@@ -53,6 +53,7 @@ static inline bool psw_in(void);
 static inline void attention(void);
 static inline void place_bit0(void);
 static inline void place_bit1(void);
+static inline bool place_stop(void);
 static inline void send_byte(uint8_t data);
 static inline bool read_bit(void);
 static inline uint8_t read_byte(void);
@@ -60,6 +61,9 @@ static inline uint8_t wait_data_lo(uint8_t us);
 static inline uint8_t wait_data_hi(uint8_t us);
 
 
+static bool srq = false;
+
+
 void adb_host_init(void)
 {
     data_hi();
@@ -75,36 +79,110 @@ bool adb_host_psw(void)
 }
 #endif
 
-uint16_t adb_host_kbd_recv(void)
+// Service Request seen at stop bit of last command
+bool adb_host_srq(void)
+{
+    return srq;
+}
+
+// Talk: read len bytes of register from device
+// returns len, or 0 when device has no data or reading failed
+uint8_t adb_host_talk_buf(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len)
 {
-    uint16_t data = 0;
     attention();
-    send_byte(0x2C);            // Addr:Keyboard(0010), Cmd:Talk(11), Register0(00)
-    place_bit0();               // Stopbit(0)
+    send_byte(ADB_CMD_TALK(addr, reg));
+    srq = place_stop();         // Stopbit(0)
     if (!wait_data_lo(0xFF))    // Tlt/Stop to Start(140-260us)
         return 0;               // No data to send
     if (!read_bit())            // Startbit(1)
-        return -2;
-    data = read_byte();
-    data = (data<<8) | read_byte();
+        return 0;
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = read_byte();
+    }
     if (read_bit())             // Stopbit(0)
-        return -3;
-    return data;
+        return 0;
+    return len;
 }
 
-// send state of LEDs
-void adb_host_kbd_led(uint8_t led)
+// Listen: write len bytes to register of device
+void adb_host_listen_buf(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len)
 {
     attention();
-    send_byte(0x2A);            // Addr:Keyboard(0010), Cmd:Listen(10), Register2(10)
-    place_bit0();               // Stopbit(0)
+    send_byte(ADB_CMD_LISTEN(addr, reg));
+    srq = place_stop();         // Stopbit(0)
     _delay_us(200);             // Tlt/Stop to Start
     place_bit1();               // Startbit(1)
-    send_byte(0);               // send upper byte (not used)
-    send_byte(led&0x07);        // send lower byte (bit2: ScrollLock, bit1: CapsLock, bit0: NumLock)
+    for (uint8_t i = 0; i < len; i++) {
+        send_byte(buf[i]);
+    }
     place_bit0();               // Stopbit(0);
 }
 
+// Flush: clear pending data of device
+void adb_host_flush(uint8_t addr)
+{
+    attention();
+    send_byte(ADB_CMD_FLUSH(addr));
+    srq = place_stop();         // Stopbit(0)
+}
+
+// Talk 16bit register, 0 when no data
+uint16_t adb_host_talk(uint8_t addr, uint8_t reg)
+{
+    uint8_t buf[2];
+    if (!adb_host_talk_buf(addr, reg, buf, 2))
+        return 0;
+    return (buf[0]<<8) | buf[1];
+}
+
+// Listen 16bit register
+void adb_host_listen(uint8_t addr, uint8_t reg, uint8_t data_h, uint8_t data_l)
+{
+    uint8_t buf[2] = { data_h, data_l };
+    adb_host_listen_buf(addr, reg, buf, 2);
+}
+
+// Move device to new address by Listen Register3 with handler 0xFE, which
+// changes address only if no collision was detected at last Talk.
+// When some devices share an address, one of them moves at a time.
+// returns true if a device answers at new address
+bool adb_host_move(uint8_t from, uint8_t to)
+{
+    uint8_t reg3[2];
+    if (!adb_host_talk_buf(from, 3, reg3, 2))
+        return false;
+    adb_host_listen(from, 3, (reg3[0] & 0xF0) | (to & 0x0F), 0xFE);
+    return adb_host_talk_buf(to, 3, reg3, 2);
+}
+
+// Change handler ID of device by Listen Register3 and read it back
+// Talk Register3 returns random address, so address is given from addr.
+// returns handler ID when device accepts it, 0 otherwise
+uint8_t adb_host_set_handler(uint8_t addr, uint8_t handler)
+{
+    uint8_t reg3[2];
+    if (!adb_host_talk_buf(addr, 3, reg3, 2))
+        return 0;
+    adb_host_listen(addr, 3, (reg3[0] & 0xF0) | (addr & 0x0F), handler);
+    if (!adb_host_talk_buf(addr, 3, reg3, 2))
+        return 0;
+    if (reg3[1] != handler)
+        return 0;
+    return handler;
+}
+
+uint16_t adb_host_kbd_recv(void)
+{
+    return adb_host_talk(ADB_ADDR_KEYBOARD, 0);
+}
+
+// send state of LEDs
+void adb_host_kbd_led(uint8_t led)
+{
+    // Register2: upper byte(not used), lower byte(bit2: ScrollLock, bit1: CapsLock, bit0: NumLock)
+    adb_host_listen(ADB_ADDR_KEYBOARD, 2, 0, led&0x07);
+}
+
 
 static inline void data_lo()
 {
@@ -165,6 +243,21 @@ static inline void place_bit1(void)
     _delay_us(65);
 }
 
+// Stop bit of command: a device which has data to send keeps the line low
+// up to 300us(Srq). Returns true if Srq is seen after the line is released.
+static inline bool place_stop(void)
+{
+    bool req;
+    data_lo();
+    _delay_us(65);
+    data_hi();
+    _delay_us(35);
+    req = !data_in();
+    if (req)
+        wait_data_hi(0xFF);
+    return req;
+}
+
 static inline void send_byte(uint8_t data)
 {
     for (int i = 0; i < 8; i++) {
@@ -304,6 +397,7 @@ Commands
 
     The command to read keycodes from keyboard is 0x2C which
     consist of keyboard address 2 and Talk against register 0. 
+    ADB_CMD_TALK/LISTEN/FLUSH in adb.h make these commands.
 
     Address:
     2:  keyboard
@@ -358,6 +452,9 @@ Communication
     Send request from device(Srq):
     Device can request to send at commad(Global only?) stop bit.
     keep low for 300us to request.
+    Device which has data asserts Srq at stop bit of commands addressed to
+    other devices, host polls it next. adb_host_srq() tells if Srq is seen
+    at the last command.
 
 
 Keyboard Data(Register0)
@@ -383,6 +480,13 @@ Keyboard Data(Register0)
     also read from Data line. It uses 0xFFFF for release scancode.
     Release code seems to delay about some 100ms. Due to Mac soft power?
 
+Keyboard Handler(Register3)
+    Handler ID in lower byte of Register3 selects mode of keyboard.
+    Extended keyboard(AEK, AEK II and later) supports handler 3, where right
+    modifiers have their own keycodes instead of sharing left ones:
+    Right Shift 0x7B, Right Option 0x7C and Right Control 0x7D.
+    Handler can be changed with Listen Register3 and confirmed with Talk.
+
 Keyboard LEDs & state of keys(Register2)
     This register hold current state of three LEDs and nine keys.
     The state of LEDs can be changed by sending Listen command.
@@ -38,6 +38,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef ADB_H
 #define ADB_H
 
+#include <stdint.h>
 #include <stdbool.h>
 
 #if !(defined(ADB_PORT) && \
@@ -47,9 +48,26 @@ POSSIBILITY OF SUCH DAMAGE.
 #   error "ADB port setting is required in config.h"
 #endif
 
+#define ADB_ADDR_KEYBOARD   2
+#define ADB_ADDR_MOUSE      3
+
+#define ADB_HANDLER_EXTENDED_KEYBOARD   3
+
+#define ADB_CMD_FLUSH(addr)         ((addr)<<4 | 0x01)
+#define ADB_CMD_LISTEN(addr, reg)   ((addr)<<4 | 0x08 | (reg))
+#define ADB_CMD_TALK(addr, reg)     ((addr)<<4 | 0x0C | (reg))
+
 // ADB host
 void     adb_host_init(void);
 bool     adb_host_psw(void);
+bool     adb_host_srq(void);
+uint8_t  adb_host_talk_buf(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+void     adb_host_listen_buf(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+void     adb_host_flush(uint8_t addr);
+uint16_t adb_host_talk(uint8_t addr, uint8_t reg);
+void     adb_host_listen(uint8_t addr, uint8_t reg, uint8_t data_h, uint8_t data_l);
+bool     adb_host_move(uint8_t from, uint8_t to);
+uint8_t  adb_host_set_handler(uint8_t addr, uint8_t handler);
 uint16_t adb_host_kbd_recv(void);
 void     adb_host_kbd_led(uint8_t led);
 
@@ -69,4 +69,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define ADB_DATA_BIT    0
 //#define ADB_PSW_BIT     1       // optional
 
+/* ADB polling: interval when idle and time to keep full rate after data(ms) */
+//#define ADB_POLL_IDLE     8
+//#define ADB_ACTIVE_TIME   500
+
+/* ADB mouse: max number of mice on the bus */
+//#define ADB_MICE_MAX      2
+
 #endif
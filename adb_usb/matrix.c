@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "debug.h"
 #include "host.h"
 #include "led.h"
+#include "timer.h"
 #include "adb.h"
 #include "matrix.h"
 
@@ -40,6 +41,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define CAPS        0x39
 #define CAPS_UP     (CAPS | 0x80)
+#define POWER       0x7F
+#define POWER_UP    (POWER | 0x80)
 #define ROW(key)    ((key)>>3&0x0F)
 #define COL(key)    ((key)&0x07)
 
@@ -55,10 +58,46 @@ static uint16_t *matrix;
 static uint16_t _matrix0[MATRIX_ROWS];
 #endif
 
-#ifdef MATRIX_HAS_GHOST
-static bool matrix_has_ghost_in_row(uint8_t row);
-#endif
 static void _register_key(uint8_t key);
+static bool poll_due(void);
+static void polled(bool data);
+
+
+/*
+ * Polling scheduler
+ * A poll(Talk R0) holds bus and CPU for 2-3ms even when keyboard has nothing
+ * to send. Keyboard is polled on every scan while keys are active and only
+ * every ADB_POLL_IDLE ms once ADB_ACTIVE_TIME ms has passed without data
+ * and with all keys released. Srq at stop bit also brings full rate back.
+ */
+#ifndef ADB_POLL_IDLE
+#   define ADB_POLL_IDLE    8       // ms
+#endif
+#ifndef ADB_ACTIVE_TIME
+#   define ADB_ACTIVE_TIME  500     // ms
+#endif
+static bool active = true;
+static uint16_t last_active = 0;
+static uint16_t last_poll = 0;
+
+#ifdef ADB_MOUSE_ENABLE
+/*
+ * Mice on the same bus
+ * Mice at default address 3 are moved one by one to addresses from
+ * ADB_MOUSE_ADDR, which separates devices sharing the address. Then keyboard
+ * and mice are polled in turn: a device which has sent data is polled again
+ * unless another device requests service with Srq.
+ */
+#ifndef ADB_MICE_MAX
+#   define ADB_MICE_MAX     2
+#endif
+#define ADB_MOUSE_ADDR      8
+static uint8_t mice = 0;
+static uint8_t poll_index = 0;  // 0: keyboard, n: mouse at ADB_MOUSE_ADDR+n-1
+
+static void mouse_init(void);
+static bool mouse_poll(uint8_t addr);
+#endif
 
 
 inline
@@ -76,6 +115,13 @@ uint8_t matrix_cols(void)
 void matrix_init(void)
 {
     adb_host_init();
+    // Extended keyboard: right modifiers are registered with their own codes
+    if (adb_host_set_handler(ADB_ADDR_KEYBOARD, ADB_HANDLER_EXTENDED_KEYBOARD) == ADB_HANDLER_EXTENDED_KEYBOARD) {
+        debug("ADB keyboard: extended\n");
+    }
+#ifdef ADB_MOUSE_ENABLE
+    mouse_init();
+#endif
 
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix0[i] = 0x00;
@@ -96,9 +142,14 @@ uint8_t matrix_scan(void)
     uint8_t key0, key1;
 
     _matrix_is_modified = false;
-    codes = adb_host_kbd_recv();
-    key0 = codes>>8;
-    key1 = codes&0xFF;
+
+#ifdef ADB_PSW_BIT
+    // Power key on PSW line(active low) costs nothing to read
+    if (adb_host_psw() == matrix_is_on(ROW(POWER), COL(POWER))) {
+        _matrix_is_modified = true;
+        _register_key(adb_host_psw() ? POWER_UP : POWER);
+    }
+#endif
 
 #ifdef MATRIX_HAS_LOCKING_CAPS
     // Send Caps key up event
@@ -107,6 +158,20 @@ uint8_t matrix_scan(void)
         _register_key(CAPS_UP);
     }
 #endif
+
+    if (!poll_due()) {
+        return 0;
+    }
+#ifdef ADB_MOUSE_ENABLE
+    if (poll_index) {
+        polled(mouse_poll(ADB_MOUSE_ADDR + poll_index - 1));
+        return 0;
+    }
+#endif
+    codes = adb_host_kbd_recv();
+    polled(codes);
+    key0 = codes>>8;
+    key1 = codes&0xFF;
     if (codes == 0) {                           // no keys
         return 0;
     } else if (key0 == 0xFF && key1 != 0xFF) {  // error
@@ -150,12 +215,10 @@ inline
 bool matrix_has_ghost(void)
 {
 #ifdef MATRIX_HAS_GHOST
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        if (matrix_has_ghost_in_row(i))
-            return true;
-    }
-#endif
+    return matrix_ghost_update();
+#else
     return false;
+#endif
 }
 
 inline
@@ -189,7 +252,7 @@ void matrix_print(void)
         pbin_reverse16(matrix_get_row(row));
 #endif
 #ifdef MATRIX_HAS_GHOST
-        if (matrix_has_ghost_in_row(row)) {
+        if (matrix_ghost_row(row)) {
             print(" <ghost");
         }
 #endif
@@ -210,20 +273,74 @@ uint8_t matrix_key_count(void)
     return count;
 }
 
-#ifdef MATRIX_HAS_GHOST
-inline
-static bool matrix_has_ghost_in_row(uint8_t row)
+static bool poll_due(void)
 {
-    // no ghost exists in case less than 2 keys on
-    if (((matrix[row] - 1) & matrix[row]) == 0)
+    if (adb_host_srq()) {
+        return true;
+    }
+    if (active) {
+        if (timer_elapsed(last_active) < ADB_ACTIVE_TIME || matrix_key_count()) {
+            return true;
+        }
+        active = false;
+    }
+    return timer_elapsed(last_poll) >= ADB_POLL_IDLE;
+}
+
+// remember activity and choose device to poll next
+static void polled(bool data)
+{
+    last_poll = timer_read();
+    if (data) {
+        active = true;
+        last_active = last_poll;
+    }
+#ifdef ADB_MOUSE_ENABLE
+    if (!data || adb_host_srq()) {
+        poll_index = (poll_index < mice ? poll_index + 1 : 0);
+    }
+#endif
+}
+
+#ifdef ADB_MOUSE_ENABLE
+static void mouse_init(void)
+{
+    // mice moved already when called again
+    mice = 0;
+    while (mice < ADB_MICE_MAX && adb_host_talk(ADB_MOUSE_ADDR + mice, 3)) {
+        mice++;
+    }
+    while (mice < ADB_MICE_MAX && adb_host_move(ADB_ADDR_MOUSE, ADB_MOUSE_ADDR + mice)) {
+        mice++;
+    }
+    poll_index = 0;
+    debug("ADB mice: "); debug_hex(mice); debug("\n");
+}
+
+/*
+ * Mouse Data(Register0)
+ *     15      : Button(0 when pressed)
+ *     14-8    : Y move(7bit two's complement, plus is down)
+ *     7       : Button2 of some devices(0 when pressed)
+ *     6-0     : X move(7bit two's complement, plus is right)
+ */
+static bool mouse_poll(uint8_t addr)
+{
+    uint8_t buf[2];
+    if (!adb_host_talk_buf(addr, 0, buf, 2))
         return false;
 
-    // ghost exists in case same state as other row
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) {
-        if (i != row && (matrix[i] & matrix[row]) == matrix[row])
-            return true;
+    report_mouse_t report = {};
+    if (!(buf[0] & 0x80)) report.buttons |= MOUSE_BTN1;
+    if (!(buf[1] & 0x80)) report.buttons |= MOUSE_BTN2;
+    report.y = (int8_t)(buf[0]<<1)>>1;
+    report.x = (int8_t)(buf[1]<<1)>>1;
+    host_mouse_send(&report);
+
+    if (debug_mouse) {
+        print("adb mouse: "); phex(addr); print(" "); phex(buf[0]); phex(buf[1]); print("\n");
     }
-    return false;
+    return true;
 }
 #endif
 
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "matrix.h"
 #include "bootloader.h"
 #include "command.h"
+#include "keyboard.h"
 
 #ifdef HOST_PJRC
 #   include "usb_keyboard.h"
@@ -39,28 +40,42 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #   include "usbdrv.h"
 #endif
 
+#ifdef LATENCY_ENABLE
+#   include "latency.h"
+#endif
+
+#if defined(PS2_INT_VECT) || defined(PS2_USART_RX_VECT)
+#   include "ps2.h"
+#endif
+
 
 static uint8_t command_common(void);
 static void help(void);
 static void switch_layer(uint8_t layer);
 
 static bool last_print_enable;
+// key of command processed, not processed again until it is released
+static uint8_t command_key = KB_NO;
 
 uint8_t command_proc(void)
 {
-    uint8_t processed = 0;
     last_print_enable = print_enable;
 
-    if (!IS_COMMAND())
+    if (!IS_COMMAND()) {
+        command_key = KB_NO;
         return 0;
+    }
 
-    print_enable = true;
-    if (command_extra() || command_common()) {
-        processed = 1;
-        _delay_ms(500);
+    uint8_t key = host_get_first_key();
+    if (key != command_key) {
+        command_key = KB_NO;
+        print_enable = true;
+        if (command_extra() || command_common()) {
+            command_key = key;
+        }
+        print_enable = last_print_enable;
     }
-    print_enable = last_print_enable;
-    return processed;
+    return (command_key != KB_NO);
 }
 
 /* This allows to define extra commands. return 0 when not processed. */
@@ -138,6 +153,18 @@ static uint8_t command_common(void)
             }
             break;
         case KB_S:
+            print("keyboard_report_suppressed: "); phex16(keyboard_report_suppressed); print("\n");
+#ifdef LATENCY_ENABLE
+            latency_print();
+            latency_clear();
+#endif
+#if defined(PS2_INT_VECT) || defined(PS2_USART_RX_VECT)
+            print("ps2_rx_high: "); phex(ps2_rx_stat.high); print("\n");
+            print("ps2_rx_overflow: "); phex16(ps2_rx_stat.overflow); print("\n");
+#endif
+#ifdef PS2_INT_VECT
+            print("ps2_rx_parity_error: "); phex16(ps2_rx_parity_error); print("\n");
+#endif
 #ifdef HOST_PJRC
             print("UDCON: "); phex(UDCON); print("\n");
             print("UDIEN: "); phex(UDIEN); print("\n");
@@ -170,19 +197,7 @@ static uint8_t command_common(void)
         case KB_ESC:
             host_clear_keyboard_report();
             host_send_keyboard_report();
-#ifdef HOST_PJRC
-            if (suspend && remote_wakeup) {
-                usb_remote_wakeup();
-            } else {
-                host_system_send(SYSTEM_POWER_DOWN);
-                host_system_send(0);
-                _delay_ms(500);
-            }
-#else
-            host_system_send(SYSTEM_POWER_DOWN);
-            host_system_send(0);
-            _delay_ms(500);
-#endif
+            keyboard_system_tap(SYSTEM_POWER_DOWN);
             break;
 #endif
         case KB_BSPC:
@@ -2,6 +2,7 @@ SRC +=	host.c \
 	keyboard.c \
 	command.c \
 	layer.c \
+	ghost.c \
 	timer.c \
 	print.c \
 	bootloader.c \
@@ -20,6 +21,10 @@ ifdef PS2_MOUSE_ENABLE
     OPT_DEFS += -DPS2_MOUSE_ENABLE
 endif
 
+ifdef ADB_MOUSE_ENABLE
+    OPT_DEFS += -DADB_MOUSE_ENABLE
+endif
+
 ifdef EXTRAKEY_ENABLE
     OPT_DEFS += -DEXTRAKEY_ENABLE
 endif
@@ -28,7 +33,16 @@ ifdef NKRO_ENABLE
     OPT_DEFS += -DNKRO_ENABLE
 endif
 
-ifdef $(or MOUSEKEY_ENABLE, PS2_MOUSE_ENABLE)
+ifdef KEYMAP_CACHE_ENABLE
+    OPT_DEFS += -DKEYMAP_CACHE_ENABLE
+endif
+
+ifdef LATENCY_ENABLE
+    SRC += latency.c
+    OPT_DEFS += -DLATENCY_ENABLE
+endif
+
+ifneq ($(MOUSEKEY_ENABLE)$(PS2_MOUSE_ENABLE)$(ADB_MOUSE_ENABLE),)
     OPT_DEFS += -DMOUSE_ENABLE
 endif
 
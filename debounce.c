@@ -0,0 +1,232 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Debounce of key matrix
+ *
+ * Scan driver reads raw state of all rows and calls debounce() to update
+ * its matrix state(cooked). Algorithm is selected with DEBOUNCE_TYPE in
+ * config.h, see matrix.h.
+ *
+ * DEBOUNCE_SYM is compatible with former global debouncing of macway, any
+ * bounce on matrix holds all keys. Per-key algorithms keep 2 or 3 bit ms
+ * counter of each key in bit-sliced form, which costs 2 or 3 bytes a row.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+#include "print.h"
+#include "debug.h"
+#include "matrix.h"
+
+
+#ifndef DEBOUNCE
+#   define DEBOUNCE 5
+#endif
+#ifndef DEBOUNCE_TYPE
+#   define DEBOUNCE_TYPE DEBOUNCE_SYM
+#endif
+
+
+#if (DEBOUNCE == 0)
+/* no debouncing: raw state is taken as it is */
+void debounce_init(void)
+{
+}
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[])
+{
+    bool changed = false;
+
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        if (cooked[i] != raw[i]) {
+            cooked[i] = raw[i];
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+#elif (DEBOUNCE_TYPE == DEBOUNCE_SYM)
+static matrix_row_t raw_prev[MATRIX_ROWS];
+static bool debouncing = false;
+static uint16_t debounce_time = 0;
+
+void debounce_init(void)
+{
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) raw_prev[i] = 0;
+    debouncing = false;
+}
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[])
+{
+    bool changed = false;
+
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        if (raw[i] != raw_prev[i]) {
+            raw_prev[i] = raw[i];
+            if (debouncing) {
+                debug("bounce!: "); debug_hex(timer_elapsed(debounce_time)); debug("\n");
+            }
+            debouncing = true;
+            debounce_time = timer_read();
+        }
+    }
+
+    if (debouncing && timer_elapsed(debounce_time) >= DEBOUNCE) {
+        for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+            if (cooked[i] != raw[i]) {
+                cooked[i] = raw[i];
+                changed = true;
+            }
+        }
+        debouncing = false;
+    }
+    return changed;
+}
+
+#elif (DEBOUNCE_TYPE == DEBOUNCE_EAGER || DEBOUNCE_TYPE == DEBOUNCE_DEFER)
+#if (DEBOUNCE <= 3)
+#   define COUNTER_BITS 2
+#elif (DEBOUNCE <= 7)
+#   define COUNTER_BITS 3
+#else
+#   error "DEBOUNCE must not exceed 7 with per-key debounce"
+#endif
+
+/*
+ * Vertical counters: bit n of ms counter of each key is held in cnt<n>[row]
+ * at the bit of its column, so counters of all keys in a row are updated
+ * at once with a few bitwise operations.
+ */
+static matrix_row_t cnt0[MATRIX_ROWS];
+static matrix_row_t cnt1[MATRIX_ROWS];
+#if (COUNTER_BITS > 2)
+static matrix_row_t cnt2[MATRIX_ROWS];
+#endif
+static uint16_t last_time = 0;
+
+// all columns on if bit n of DEBOUNCE is on
+#define DEBOUNCE_BIT(n) ((DEBOUNCE & (1<<(n))) ? (matrix_row_t)~0 : 0)
+
+
+/* increment counters of keys in mask */
+static inline void count_up(uint8_t row, matrix_row_t mask)
+{
+    matrix_row_t carry = cnt0[row] & mask;
+    cnt0[row] ^= mask;
+#if (COUNTER_BITS > 2)
+    matrix_row_t carry1 = cnt1[row] & carry;
+    cnt2[row] ^= carry1;
+#endif
+    cnt1[row] ^= carry;
+}
+
+/* keys whose counter is DEBOUNCE */
+static inline matrix_row_t count_done(uint8_t row)
+{
+    return ~(cnt0[row] ^ DEBOUNCE_BIT(0)) &
+#if (COUNTER_BITS > 2)
+           ~(cnt2[row] ^ DEBOUNCE_BIT(2)) &
+#endif
+           ~(cnt1[row] ^ DEBOUNCE_BIT(1));
+}
+
+static inline void count_clear(uint8_t row, matrix_row_t mask)
+{
+    cnt0[row] &= ~mask;
+    cnt1[row] &= ~mask;
+#if (COUNTER_BITS > 2)
+    cnt2[row] &= ~mask;
+#endif
+}
+
+#if (DEBOUNCE_TYPE == DEBOUNCE_EAGER)
+/* keys counting: non-zero counter */
+static inline matrix_row_t count_active(uint8_t row)
+{
+#if (COUNTER_BITS > 2)
+    return cnt0[row] | cnt1[row] | cnt2[row];
+#else
+    return cnt0[row] | cnt1[row];
+#endif
+}
+#endif
+
+
+void debounce_init(void)
+{
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        count_clear(i, (matrix_row_t)~0);
+    }
+    last_time = timer_read();
+}
+
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[])
+{
+    bool changed = false;
+
+    // counters go up once for each ms passed since last scan
+    uint16_t now = timer_read();
+    uint16_t t = TIMER_DIFF_MS(now, last_time);
+    uint8_t ticks = (t > DEBOUNCE ? DEBOUNCE : t);
+    last_time = now;
+
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t diff = raw[row] ^ cooked[row];
+#if (DEBOUNCE_TYPE == DEBOUNCE_EAGER)
+        matrix_row_t active = count_active(row);
+        if (!diff && !active) continue;
+
+        // keys ignored since reported: released after DEBOUNCE ticks
+        for (uint8_t i = ticks; i && active; i--) {
+            matrix_row_t done = count_done(row) & active;
+            count_clear(row, done);
+            active &= ~done;
+            count_up(row, active);
+        }
+
+        // report at once and ignore the keys until they settle
+        matrix_row_t start = diff & ~active;
+        if (start) {
+            cooked[row] ^= start;
+            cnt0[row] |= start;     // count from 1
+            changed = true;
+        }
+#else
+        // keys bounced back to reported state count again from 0
+        count_clear(row, ~diff);
+        if (!diff) continue;
+
+        for (uint8_t i = ticks; i && diff; i--) {
+            count_up(row, diff);
+            matrix_row_t done = count_done(row) & diff;
+            if (done) {
+                cooked[row] ^= done;
+                count_clear(row, done);
+                diff &= ~done;
+                changed = true;
+            }
+        }
+#endif
+    }
+    return changed;
+}
+
+#else
+#   error "DEBOUNCE_TYPE is not valid"
+#endif
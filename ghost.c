@@ -0,0 +1,81 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Ghost detection
+ *
+ * On matrix without diodes a key at fourth corner of rectangle whose other
+ * three corners are pressed reads as pressed, and it can't be told from
+ * real press. Rectangle needs two rows sharing two columns, so columns
+ * used by two rows or more are accumulated in one pass over rows and keys
+ * on those columns are ambiguous in rows which have two of them or more.
+ * This can also flag rows which share columns with different rows, which
+ * is safe side.
+ *
+ * keyboard.c keeps last state of ambiguous keys and other keys are
+ * reported as usual.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+
+#ifdef MATRIX_HAS_GHOST
+
+static matrix_row_t ghost[MATRIX_ROWS];
+static bool has_ghost = false;
+
+
+bool matrix_ghost_update(void)
+{
+    // columns used by one row or more and two rows or more
+    matrix_row_t once = 0;
+    matrix_row_t twice = 0;
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        matrix_row_t row = matrix_get_row(i);
+        twice |= once & row;
+        once |= row;
+    }
+
+    // no ghost without two shared columns
+    if (!(twice & (twice - 1))) {
+        if (has_ghost) {
+            for (uint8_t i = 0; i < MATRIX_ROWS; i++) ghost[i] = 0;
+            has_ghost = false;
+        }
+        return false;
+    }
+
+    has_ghost = false;
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        matrix_row_t shared = matrix_get_row(i) & twice;
+        if (shared & (shared - 1)) {
+            ghost[i] = shared;
+            has_ghost = true;
+        } else {
+            ghost[i] = 0;
+        }
+    }
+    return has_ghost;
+}
+
+matrix_row_t matrix_ghost_row(uint8_t row)
+{
+    return ghost[row];
+}
+
+#endif
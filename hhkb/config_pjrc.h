@@ -34,6 +34,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MATRIX_COLS 8
 /* define if matrix has ghost */
 //#define MATRIX_HAS_GHOST
+/* sweep hot keys more often than others(see matrix.c)
+ * NOTE: first press of a cold key can take up to HHKB_FULL_SCAN_INTERVAL
+ * scans to be seen, check it with LATENCY_ENABLE before turning on */
+//#define HHKB_ADAPTIVE_SCAN
 
 
 /* key combination for command */
@@ -27,6 +27,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "timer.h"
 #include "matrix.h"
+#ifdef HHKB_ADAPTIVE_SCAN
+#   include "usb_keycodes.h"
+#   include "keymap.h"
+#endif
 
 
 // Timer resolution check
@@ -43,22 +47,37 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 // matrix state buffer(1:on, 0:off)
-#if (MATRIX_COLS <= 8)
-static uint8_t *matrix;
-static uint8_t *matrix_prev;
-static uint8_t _matrix0[MATRIX_ROWS];
-static uint8_t _matrix1[MATRIX_ROWS];
-#else
-static uint16_t *matrix;
-static uint16_t *matrix_prev;
-static uint16_t _matrix0[MATRIX_ROWS];
-static uint16_t _matrix1[MATRIX_ROWS];
+static matrix_row_t *matrix;
+static matrix_row_t *matrix_prev;
+static matrix_row_t _matrix0[MATRIX_ROWS];
+static matrix_row_t _matrix1[MATRIX_ROWS];
+
+/*
+ * Adaptive scan(HHKB_ADAPTIVE_SCAN)
+ * Full sweep of all keys is done once in HHKB_FULL_SCAN_INTERVAL scans and
+ * other scans sweep only hot keys: modifiers, Fn keys, keys on and keys
+ * changed recently. Hot keys are sampled several times as often as full
+ * sweep and any key is still visited at least once in the interval.
+ * Trade-off: first press of a cold key(most letters) waits for the next
+ * full sweep, so its worst-case latency grows to about the interval times
+ * time of a full sweep. Off by default, measure with LATENCY_ENABLE.
+ */
+#ifdef HHKB_ADAPTIVE_SCAN
+#   ifndef HHKB_FULL_SCAN_INTERVAL
+#       define HHKB_FULL_SCAN_INTERVAL  8
+#   endif
+// keys changed in this many full sweeps are hot
+#   ifndef HHKB_RECENT_SWEEPS
+#       define HHKB_RECENT_SWEEPS       16
+#   endif
+static matrix_row_t hot_fixed[MATRIX_ROWS];
+static matrix_row_t recent[MATRIX_ROWS];
+static matrix_row_t recent_old[MATRIX_ROWS];
+static uint8_t sweep_count = 0;
+static uint8_t full_count = 0;
 #endif
 
 // HHKB has no ghost and no bounce.
-#ifdef MATRIX_HAS_GHOST
-static bool matrix_has_ghost_in_row(uint8_t row);
-#endif
 
 
 // Matrix I/O ports
@@ -150,56 +169,154 @@ void matrix_init(void)
     for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix1[i] = 0x00;
     matrix = _matrix0;
     matrix_prev = _matrix1;
+
+#ifdef HHKB_ADAPTIVE_SCAN
+    // first scan is full sweep
+    sweep_count = HHKB_FULL_SCAN_INTERVAL - 1;
+    full_count = 0;
+    // modifiers and Fn keys on default layer are always hot
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        hot_fixed[row] = 0;
+        recent[row] = 0;
+        recent_old[row] = 0;
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            uint8_t code = keymap_get_keycode(0, row, col);
+            if (IS_MOD(code) || IS_FN(code)) {
+                hot_fixed[row] |= (1<<col);
+            }
+        }
+    }
+#endif
+}
+
+/*
+ * Scan timing
+ * Each key is selected and its KEY_STATE is read after select lines
+ * settle. Waits are measured with TIMER_RAW from select instead of fixed
+ * delays, and recovery time of KEY_STATE after KEY_UNABLE(25us or more)
+ * overlaps with settle time of next key. A read whose 20us window after
+ * KEY_ENABLE was stretched by interrupt is retried at once.
+ */
+#ifndef HHKB_SETTLE_US
+#   define HHKB_SETTLE_US   40      // select lines to KEY_PREV
+#endif
+#ifndef HHKB_SCAN_RETRY
+#   define HHKB_SCAN_RETRY  3
+#endif
+
+#define US_TO_RAW(us)       (((uint32_t)(us) * TIMER_RAW_FREQ + 999999) / 1000000)
+#define RAW_ELAPSED(last)   TIMER_DIFF(TIMER_RAW, (last), TIMER_RAW_TOP + 1)
+
+#if (HHKB_SETTLE_US + 7 < 25)
+#   error "HHKB_SETTLE_US is too short for KEY_STATE to return to idle state."
+#endif
+
+// scan statistics
+static uint16_t scan_count = 0;
+static uint16_t scan_rate = 0;      // full scans per second
+static uint16_t scan_timer = 0;
+static uint16_t read_retried = 0;
+static uint16_t read_skipped = 0;
+
+/* read a key. returns false when read is not valid. */
+static inline bool read_key(uint8_t row, uint8_t col, bool *on)
+{
+    KEY_SELECT(row, col);
+    uint8_t start = TIMER_RAW;
+
+    // wait +1 tick since start is read at any point in a tick
+    while (RAW_ELAPSED(start) < US_TO_RAW(HHKB_SETTLE_US) + 1) ;
+
+    // Not sure this is needed. This just emulates HHKB controller's behaviour.
+    if (matrix_prev[row] & (1<<col)) {
+        KEY_PREV_ON();
+    }
+    _delay_us(7);
+
+    // NOTE: KEY_STATE is valid only in 20us after KEY_ENABLE.
+    // If V-USB interrupts in this section we could lose 40us or so
+    // and would read invalid value from KEY_STATE.
+    uint8_t last = TIMER_RAW;
+
+    KEY_ENABLE();
+    // Wait for KEY_STATE outputs its value.
+    // 1us was ok on one HHKB, but not worked on another.
+    _delay_us(10);
+    *on = !KEY_STATE();
+    bool valid = (RAW_ELAPSED(last) <= 20/(1000000/TIMER_RAW_FREQ));
+
+    KEY_PREV_OFF();
+    KEY_UNABLE();
+    return valid;
 }
 
 uint8_t matrix_scan(void)
 {
-    uint8_t *tmp;
+    matrix_row_t *tmp;
 
     tmp = matrix_prev;
     matrix_prev = matrix;
     matrix = tmp;
 
+#ifdef HHKB_ADAPTIVE_SCAN
+    bool full = (++sweep_count >= HHKB_FULL_SCAN_INTERVAL);
+    if (full) sweep_count = 0;
+#endif
+
     KEY_POWER_ON();
     for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t state = 0;
+#ifdef HHKB_ADAPTIVE_SCAN
+        matrix_row_t hot = hot_fixed[row] | matrix_prev[row] | recent[row] | recent_old[row];
+        if (!full) {
+            // keys not visited keep their state
+            state = matrix_prev[row] & ~hot;
+        }
+#endif
         for (uint8_t col = 0; col < MATRIX_COLS; col++) {
-            KEY_SELECT(row, col);
-            _delay_us(40);
-
-            // Not sure this is needed. This just emulates HHKB controller's behaviour.
-            if (matrix_prev[row] & (1<<col)) {
-                KEY_PREV_ON();
-            }
-            _delay_us(7);
-
-            // NOTE: KEY_STATE is valid only in 20us after KEY_ENABLE.
-            // If V-USB interrupts in this section we could lose 40us or so
-            // and would read invalid value from KEY_STATE.
-            uint8_t last = TIMER_RAW;
-
-            KEY_ENABLE();
-            // Wait for KEY_STATE outputs its value.
-            // 1us was ok on one HHKB, but not worked on another.
-            _delay_us(10);
-            if (KEY_STATE()) {
-                matrix[row] &= ~(1<<col);
-            } else {
-                matrix[row] |= (1<<col);
-            }
-
-            // Ignore if this code region execution time elapses more than 20us.
-            if (TIMER_DIFF_RAW(TIMER_RAW, last) > 20/(1000000/TIMER_RAW_FREQ)) {
-                matrix[row] = matrix_prev[row];
+#ifdef HHKB_ADAPTIVE_SCAN
+            if (!full && !(hot & (1<<col))) continue;
+#endif
+            bool on;
+            uint8_t tries = 0;
+            while (!read_key(row, col, &on)) {
+                if (++tries > HHKB_SCAN_RETRY) {
+                    // keep previous state of this key only
+                    on = matrix_prev[row] & (1<<col);
+                    read_skipped++;
+                    break;
+                }
+                read_retried++;
             }
-
-            KEY_PREV_OFF();
-            KEY_UNABLE();
-            // NOTE: KEY_STATE keep its state in 20us after KEY_ENABLE.
-            // This takes 25us or more to make sure KEY_STATE returns to idle state.
-            _delay_us(150);
+            if (on) state |= (1<<col);
         }
+        matrix[row] = state;
+#ifdef HHKB_ADAPTIVE_SCAN
+        recent[row] |= state ^ matrix_prev[row];
+#endif
     }
     KEY_POWER_OFF();
+
+#ifdef HHKB_ADAPTIVE_SCAN
+    // age recently changed keys
+    if (full && ++full_count >= HHKB_RECENT_SWEEPS) {
+        full_count = 0;
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            recent_old[row] = recent[row];
+            recent[row] = 0;
+        }
+    }
+#endif
+
+#ifdef HHKB_ADAPTIVE_SCAN
+    if (full)
+#endif
+        scan_count++;
+    if (timer_elapsed(scan_timer) >= 1000) {
+        scan_rate = scan_count;
+        scan_count = 0;
+        scan_timer = timer_read();
+    }
     return 1;
 }
 
@@ -216,12 +333,10 @@ inline
 bool matrix_has_ghost(void)
 {
 #ifdef MATRIX_HAS_GHOST
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        if (matrix_has_ghost_in_row(i))
-            return true;
-    }
-#endif
+    return matrix_ghost_update();
+#else
     return false;
+#endif
 }
 
 inline
@@ -231,11 +346,7 @@ bool matrix_is_on(uint8_t row, uint8_t col)
 }
 
 inline
-#if (MATRIX_COLS <= 8)
-uint8_t matrix_get_row(uint8_t row)
-#else
-uint16_t matrix_get_row(uint8_t row)
-#endif
+matrix_row_t matrix_get_row(uint8_t row)
 {
     return matrix[row];
 }
@@ -255,12 +366,15 @@ void matrix_print(void)
         pbin_reverse16(matrix_get_row(row));
 #endif
 #ifdef MATRIX_HAS_GHOST
-        if (matrix_has_ghost_in_row(row)) {
+        if (matrix_ghost_row(row)) {
             print(" <ghost");
         }
 #endif
         print("\n");
     }
+    print("scan rate: "); phex16(scan_rate);
+    print(" retried: "); phex16(read_retried);
+    print(" skipped: "); phex16(read_skipped); print("\n");
 }
 
 uint8_t matrix_key_count(void)
@@ -276,19 +390,3 @@ uint8_t matrix_key_count(void)
     return count;
 }
 
-#ifdef MATRIX_HAS_GHOST
-inline
-static bool matrix_has_ghost_in_row(uint8_t row)
-{
-    // no ghost exists in case less than 2 keys on
-    if (((matrix[row] - 1) & matrix[row]) == 0)
-        return false;
-
-    // ghost exists in case same state as other row
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) {
-        if (i != row && (matrix[i] & matrix[row]) == matrix[row])
-            return true;
-    }
-    return false;
-}
-#endif
@@ -16,26 +16,57 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <avr/interrupt.h>
 #include "usb_keycodes.h"
 #include "host.h"
 #include "util.h"
 #include "debug.h"
+#ifdef LATENCY_ENABLE
+#   include "latency.h"
+#endif
 
 
 #ifdef NKRO_ENABLE
 bool keyboard_nkro = false;
 #endif
 
+/*
+ * 6KRO slot allocation
+ * Each report buffer carries bitmask of its empty slots and number of keys
+ * which didn't fit in, with bitmap of those keycodes so that only their
+ * release reduces the count. key_slot[] remembers slot that keycode used
+ * last so that a key keeps its position across reports and is found in O(1).
+ */
+#define KEY_SLOTS       6
+#define KEY_SLOTS_ALL   ((1<<KEY_SLOTS) - 1)
+
+typedef struct {
+    report_keyboard_t report;   // should be first member
+    uint8_t free;
+    uint8_t overflow;
+    uint8_t overflowed[KB_EXSEL/8 + 1];
+} slot_report_t;
+#define SLOT_REPORT(r)  ((slot_report_t *)(r))
+
+// slot index of keycode in nibble
+static uint8_t key_slot[KB_EXSEL/2 + 1];
+
 static host_driver_t *driver;
-static report_keyboard_t report0;
-static report_keyboard_t report1;
-report_keyboard_t *keyboard_report = &report0;
-report_keyboard_t *keyboard_report_prev = &report1;
+static slot_report_t report0 = { .free = KEY_SLOTS_ALL };
+static slot_report_t report1 = { .free = KEY_SLOTS_ALL };
+report_keyboard_t *keyboard_report = &report0.report;
+report_keyboard_t *keyboard_report_prev = &report1.report;
 
+// last report sent to host
+static report_keyboard_t report_sent;
 
+
+static inline uint8_t get_key_slot(uint8_t code);
 static inline void add_key_byte(uint8_t code);
 static inline void add_key_bit(uint8_t code);
+static inline void del_key_byte(uint8_t code);
+static inline void del_key_bit(uint8_t code);
 
 
 void host_set_driver(host_driver_t *d)
@@ -66,11 +97,27 @@ void host_add_key(uint8_t key)
     add_key_byte(key);
 }
 
+void host_del_key(uint8_t key)
+{
+#ifdef NKRO_ENABLE
+    if (keyboard_nkro) {
+        del_key_bit(key);
+        return;
+    }
+#endif
+    del_key_byte(key);
+}
+
 void host_add_mod_bit(uint8_t mod)
 {
     keyboard_report->mods |= mod;
 }
 
+void host_del_mod_bit(uint8_t mod)
+{
+    keyboard_report->mods &= ~mod;
+}
+
 void host_set_mods(uint8_t mods)
 {
     keyboard_report->mods = mods;
@@ -85,6 +132,15 @@ void host_add_code(uint8_t code)
     }
 }
 
+void host_del_code(uint8_t code)
+{
+    if (IS_MOD(code)) {
+        host_del_mod_bit(MOD_BIT(code));
+    } else {
+        host_del_key(code);
+    }
+}
+
 void host_swap_keyboard_report(void)
 {
     uint8_t sreg = SREG;
@@ -95,12 +151,44 @@ void host_swap_keyboard_report(void)
     SREG = sreg;
 }
 
+void host_copy_keyboard_report(void)
+{
+    *SLOT_REPORT(keyboard_report) = *SLOT_REPORT(keyboard_report_prev);
+}
+
 void host_clear_keyboard_report(void)
 {
     keyboard_report->mods = 0;
     for (int8_t i = 0; i < REPORT_KEYS; i++) {
         keyboard_report->keys[i] = 0;
     }
+    SLOT_REPORT(keyboard_report)->free = KEY_SLOTS_ALL;
+    SLOT_REPORT(keyboard_report)->overflow = 0;
+    for (uint8_t i = 0; i < sizeof(SLOT_REPORT(keyboard_report)->overflowed); i++) {
+        SLOT_REPORT(keyboard_report)->overflowed[i] = 0;
+    }
+}
+
+bool host_has_rollover(void)
+{
+#ifdef NKRO_ENABLE
+    if (keyboard_nkro) return false;
+#endif
+    return SLOT_REPORT(keyboard_report)->overflow;
+}
+
+/* whether key is in report or waits for slot */
+bool host_has_key(uint8_t key)
+{
+#ifdef NKRO_ENABLE
+    if (keyboard_nkro) {
+        return ((key>>3) < REPORT_KEYS && (keyboard_report->keys[key>>3] & (1<<(key&7))));
+    }
+#endif
+    if (key > KB_EXSEL) return false;
+    slot_report_t *r = SLOT_REPORT(keyboard_report);
+    return (r->report.keys[get_key_slot(key)] == key ||
+            (r->overflowed[key>>3] & (1<<(key&7))));
 }
 
 uint8_t host_has_anykey(void)
@@ -127,10 +215,36 @@ uint8_t host_get_first_key(void)
 }
 
 
-void host_send_keyboard_report(void)
+/* returns false when report is identical to last one sent */
+bool host_send_keyboard_report(void)
 {
-    if (!driver) return;
-    (*driver->send_keyboard)(keyboard_report);
+    if (!driver) return false;
+
+    report_keyboard_t *report = keyboard_report;
+    report_keyboard_t rollover;
+    if (host_has_rollover()) {
+        // ErrorRollOver in all slots while more keys than slots are down
+        rollover.mods = keyboard_report->mods;
+        rollover.rserved = 0;
+        for (int8_t i = 0; i < REPORT_KEYS; i++) {
+            rollover.keys[i] = (i < KEY_SLOTS ? KB_ROLL_OVER : 0);
+        }
+        report = &rollover;
+    }
+
+    // send only when changed from last report
+    bool changed = (report->mods != report_sent.mods);
+    for (int8_t i = 0; !changed && i < REPORT_KEYS; i++) {
+        changed = (report->keys[i] != report_sent.keys[i]);
+    }
+    if (!changed) return false;
+
+    (*driver->send_keyboard)(report);
+    report_sent = *report;
+#ifdef LATENCY_ENABLE
+    latency_report_sent();
+#endif
+    return true;
 }
 
 void host_mouse_send(report_mouse_t *report)
@@ -157,27 +271,41 @@ void host_consumer_send(uint16_t data)
 }
 
 
+static inline uint8_t get_key_slot(uint8_t code)
+{
+    return (key_slot[code>>1] >> ((code&1)<<2)) & 0x0F;
+}
+
+static inline void set_key_slot(uint8_t code, uint8_t slot)
+{
+    uint8_t shift = (code&1)<<2;
+    key_slot[code>>1] = (key_slot[code>>1] & ~(0x0F<<shift)) | (slot<<shift);
+}
+
 static inline void add_key_byte(uint8_t code)
 {
-    // TODO: fix ugly code
-    int8_t i = 0;
-    int8_t empty = -1;
-    for (; i < REPORT_KEYS; i++) {
-        if (keyboard_report_prev->keys[i] == code) {
-            keyboard_report->keys[i] = code;
-            break;
-        }
-        if (empty == -1 &&
-                keyboard_report_prev->keys[i] == 0 &&
-                keyboard_report->keys[i] == 0) {
-            empty = i;
-        }
+    slot_report_t *r = SLOT_REPORT(keyboard_report);
+    if (code > KB_EXSEL) {
+        debug("add_key_byte: can't add: "); phex(code); debug("\n");
+        return;
     }
-    if (i == REPORT_KEYS) {
-        if (empty != -1) {
-            keyboard_report->keys[empty] = code;
+
+    // keep position of key used last time
+    uint8_t slot = get_key_slot(code);
+    if (r->report.keys[slot] == code) return;
+    if (!(r->free & (1<<slot))) {
+        if (!r->free) {
+            if (!(r->overflowed[code>>3] & (1<<(code&7)))) {
+                r->overflowed[code>>3] |= (1<<(code&7));
+                r->overflow++;
+            }
+            return;
         }
+        slot = biton(r->free & -r->free);
+        set_key_slot(code, slot);
     }
+    r->report.keys[slot] = code;
+    r->free &= ~(1<<slot);
 }
 
 static inline void add_key_bit(uint8_t code)
@@ -188,3 +316,27 @@ static inline void add_key_bit(uint8_t code)
         debug("add_key_bit: can't add: "); phex(code); debug("\n");
     }
 }
+
+static inline void del_key_byte(uint8_t code)
+{
+    slot_report_t *r = SLOT_REPORT(keyboard_report);
+    if (code > KB_EXSEL) return;
+
+    uint8_t slot = get_key_slot(code);
+    if (r->report.keys[slot] == code) {
+        r->report.keys[slot] = 0;
+        r->free |= (1<<slot);
+    } else if (r->overflowed[code>>3] & (1<<(code&7))) {
+        r->overflowed[code>>3] &= ~(1<<(code&7));
+        r->overflow--;
+    }
+}
+
+static inline void del_key_bit(uint8_t code)
+{
+    if ((code>>3) < REPORT_KEYS) {
+        keyboard_report->keys[code>>3] &= ~(1<<(code&7));
+    } else {
+        debug("del_key_bit: can't del: "); phex(code); debug("\n");
+    }
+}
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define HOST_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "report.h"
 #include "host_driver.h"
 
@@ -37,16 +38,22 @@ uint8_t host_keyboard_leds(void);
 
 /* keyboard report operations */
 void host_add_key(uint8_t key);
+void host_del_key(uint8_t key);
 void host_add_mod_bit(uint8_t mod);
+void host_del_mod_bit(uint8_t mod);
 void host_set_mods(uint8_t mods);
 void host_add_code(uint8_t code);
+void host_del_code(uint8_t code);
 void host_swap_keyboard_report(void);
+void host_copy_keyboard_report(void);
 void host_clear_keyboard_report(void);
+bool host_has_rollover(void);
+bool host_has_key(uint8_t key);
 uint8_t host_has_anykey(void);
 uint8_t host_get_first_key(void);
 
 
-void host_send_keyboard_report(void);
+bool host_send_keyboard_report(void);
 void host_mouse_send(report_mouse_t *report);
 void host_system_send(uint16_t data);
 void host_consumer_send(uint16_t data);
@@ -35,6 +35,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "report.h"
 #include "host_driver.h"
 #include "iwrap.h"
+#include "ring.h"
 #include "print.h"
 
 
@@ -56,45 +57,11 @@ static uint8_t connected = 0;
 static char buf[MUX_BUF_SIZE];
 static uint8_t snd_pos = 0;
 
+/* receive buffer: responses are also parsed as string in place */
 #define MUX_RCV_BUF_SIZE 256
-static char rcv_buf[MUX_RCV_BUF_SIZE];
-static uint8_t rcv_head = 0;
-static uint8_t rcv_tail = 0;
-
-
-/* receive buffer */
-static void rcv_enq(char c)
-{
-    uint8_t next = (rcv_head + 1) % MUX_RCV_BUF_SIZE;
-    if (next != rcv_tail) {
-        rcv_buf[rcv_head] = c;
-        rcv_head = next;
-    }
-}
-
-static char rcv_deq(void)
-{
-    char c = 0;
-    if (rcv_head != rcv_tail) {
-        c = rcv_buf[rcv_tail++];
-        rcv_tail %= MUX_RCV_BUF_SIZE;
-    }
-    return c;
-}
-
-/*
-static char rcv_peek(void)
-{
-    if (rcv_head == rcv_tail)
-        return 0;
-    return rcv_buf[rcv_tail];
-}
-*/
-
-static void rcv_clear(void)
-{
-    rcv_tail = rcv_head = 0;
-}
+static volatile ring_stat_t rcv_stat;
+RING_DEFINE(rcv, MUX_RCV_BUF_SIZE, rcv_stat)
+#define RCV_STR ((char *)rcv_buf)
 
 /* iWRAP response */
 ISR(PCINT1_vect, ISR_BLOCK) // recv() runs away in case of ISR_NOBLOCK
@@ -127,7 +94,7 @@ ISR(PCINT1_vect, ISR_BLOCK) // recv() runs away in case of ISR_NOBLOCK
         default:
             if (mux_state--) {
                 uart_putchar(c);
-                rcv_enq(c);
+                rcv_put(c);
             }
     }
 }
@@ -189,7 +156,7 @@ void iwrap_call(void)
     iwrap_mux_send("SET BT PAIR");
     _delay_ms(500);
 
-    p = rcv_buf + rcv_tail;
+    p = RCV_STR + rcv_tail;
     while (!strncmp(p, "SET BT PAIR", 11)) {
         p += 7;
         strncpy(p, "CALL", 4);
@@ -230,16 +197,16 @@ void iwrap_kill(void)
     iwrap_mux_send("LIST");
     _delay_ms(500);
 
-    while ((c = rcv_deq()) && c != '\n') ;
-    if (strncmp(rcv_buf + rcv_tail, "LIST ", 5)) {
+    while ((c = rcv_get()) && c != '\n') ;
+    if (strncmp(RCV_STR + rcv_tail, "LIST ", 5)) {
         print("no connection to kill.\n");
         return;
     }
     // skip 10 'space' chars
     for (uint8_t i = 10; i; i--)
-        while ((c = rcv_deq()) && c != ' ') ;
+        while ((c = rcv_get()) && c != ' ') ;
 
-    char *p = rcv_buf + rcv_tail - 5;
+    char *p = RCV_STR + rcv_tail - 5;
     strncpy(p, "KILL ", 5);
     strncpy(p + 22, "\n\0", 2);
     print_S(p);
@@ -254,7 +221,7 @@ void iwrap_unpair(void)
     iwrap_mux_send("SET BT PAIR");
     _delay_ms(500);
 
-    char *p = rcv_buf + rcv_tail;
+    char *p = RCV_STR + rcv_tail;
     if (!strncmp(p, "SET BT PAIR", 11)) {
         strncpy(p+29, "\n\0", 2);
         print_S(p);
@@ -277,7 +244,7 @@ void iwrap_subrate(void)
 
 bool iwrap_failed(void)
 {
-    if (strncmp(rcv_buf, "SYNTAX ERROR", 12))
+    if (strncmp(RCV_STR, "SYNTAX ERROR", 12))
         return true;
     else
         return false;
@@ -293,7 +260,7 @@ uint8_t iwrap_check_connection(void)
     iwrap_mux_send("LIST");
     _delay_ms(100);
 
-    if (strncmp(rcv_buf, "LIST ", 5) || !strncmp(rcv_buf, "LIST 0", 6))
+    if (strncmp(RCV_STR, "LIST ", 5) || !strncmp(RCV_STR, "LIST 0", 6))
         connected = 0;
     else
         connected = 1;
@@ -24,16 +24,98 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "print.h"
 #include "debug.h"
 #include "command.h"
+#ifdef EXTRAKEY_ENABLE
+#include <avr/pgmspace.h>
+#endif
 #ifdef MOUSEKEY_ENABLE
 #include "mousekey.h"
 #endif
-#ifdef EXTRAKEY_ENABLE
-#include <util/delay.h>
+#ifdef LATENCY_ENABLE
+#include "latency.h"
+#endif
+
+
+#ifndef KEYEVENT_BUFFER_SIZE
+#   define KEYEVENT_BUFFER_SIZE 8
+#endif
+
+// SYSTEM_TAP_TERM: keep system usage reported at least this term(ms)
+#ifndef SYSTEM_TAP_TERM
+#   define SYSTEM_TAP_TERM 100
 #endif
 
 
 static uint8_t last_leds = 0;
 
+uint16_t keyboard_report_suppressed = 0;
+
+// matrix state which report reflects
+static matrix_row_t matrix_prev[MATRIX_ROWS];
+
+// press/release events found in this scan
+static keyevent_t events[KEYEVENT_BUFFER_SIZE];
+static uint8_t events_count = 0;
+static bool events_overflow = false;
+
+// state built up from keys held down
+static uint8_t fn_bits = 0;
+// keys held whose keycode is also held by another key: release of one can't clear it
+static uint8_t dup_keys = 0;
+#ifdef MOUSEKEY_ENABLE
+static uint8_t mousekey_held = 0;
+#endif
+#ifdef EXTRAKEY_ENABLE
+static uint32_t consumer_keys = 0;
+static uint16_t consumer_code = 0;
+static uint16_t system_code = 0;
+#endif
+
+#ifdef EXTRAKEY_ENABLE
+/* usage of System Control and Consumer keys indexed from KB_SYSTEM_POWER */
+static const uint16_t PROGMEM extrakey_usages[] = {
+    [KB_SYSTEM_POWER     - KB_SYSTEM_POWER] = SYSTEM_POWER_DOWN,
+    [KB_SYSTEM_SLEEP     - KB_SYSTEM_POWER] = SYSTEM_SLEEP,
+    [KB_SYSTEM_WAKE      - KB_SYSTEM_POWER] = SYSTEM_WAKE_UP,
+    [KB_AUDIO_MUTE       - KB_SYSTEM_POWER] = AUDIO_MUTE,
+    [KB_AUDIO_VOL_UP     - KB_SYSTEM_POWER] = AUDIO_VOL_UP,
+    [KB_AUDIO_VOL_DOWN   - KB_SYSTEM_POWER] = AUDIO_VOL_DOWN,
+    [KB_MEDIA_NEXT_TRACK - KB_SYSTEM_POWER] = TRANSPORT_NEXT_TRACK,
+    [KB_MEDIA_PREV_TRACK - KB_SYSTEM_POWER] = TRANSPORT_PREV_TRACK,
+    [KB_MEDIA_STOP       - KB_SYSTEM_POWER] = TRANSPORT_STOP,
+    [KB_MEDIA_PLAY_PAUSE - KB_SYSTEM_POWER] = TRANSPORT_PLAY_PAUSE,
+    [KB_MEDIA_SELECT     - KB_SYSTEM_POWER] = AL_CC_CONFIG,
+    [KB_MAIL             - KB_SYSTEM_POWER] = AL_EMAIL,
+    [KB_CALCULATOR       - KB_SYSTEM_POWER] = AL_CALCULATOR,
+    [KB_MY_COMPUTER      - KB_SYSTEM_POWER] = AL_LOCAL_BROWSER,
+    [KB_WWW_SEARCH       - KB_SYSTEM_POWER] = AC_SEARCH,
+    [KB_WWW_HOME         - KB_SYSTEM_POWER] = AC_HOME,
+    [KB_WWW_BACK         - KB_SYSTEM_POWER] = AC_BACK,
+    [KB_WWW_FORWARD      - KB_SYSTEM_POWER] = AC_FORWARD,
+    [KB_WWW_STOP         - KB_SYSTEM_POWER] = AC_STOP,
+    [KB_WWW_REFRESH      - KB_SYSTEM_POWER] = AC_REFRESH,
+    [KB_WWW_FAVORITES    - KB_SYSTEM_POWER] = AC_BOOKMARKS,
+};
+#define EXTRAKEY_USAGE(code)    pgm_read_word(&extrakey_usages[(code) - KB_SYSTEM_POWER])
+#define CONSUMER_BIT(code)      ((uint32_t)1<<((code) - KB_AUDIO_MUTE))
+
+// system usage requested out of matrix and usage reported to host
+static uint16_t system_tap = 0;
+static uint16_t system_sent = 0;
+static uint16_t system_timer = 0;
+#endif
+
+// layer which report was built with
+static uint8_t last_layer = 0;
+static bool need_rebuild = true;
+
+static void scan_events(bool ghost);
+static void rebuild_report(void);
+static void register_code(uint8_t code);
+static void unregister_code(uint8_t code);
+#ifdef EXTRAKEY_ENABLE
+static void system_task(void);
+#endif
+
 
 void keyboard_init(void)
 {
@@ -46,15 +128,18 @@ void keyboard_init(void)
 
 void keyboard_proc(void)
 {
-    uint8_t fn_bits = 0;
-#ifdef EXTRAKEY_ENABLE
-    uint16_t consumer_code = 0;
+#ifdef LATENCY_ENABLE
+    latency_scan_start();
 #endif
-
     matrix_scan();
+    // keys which may be ghost keep last state in scan_events()
+    bool ghost = matrix_has_ghost();
 
     if (matrix_is_modified()) {
         if (debug_matrix) matrix_print();
+#ifdef LATENCY_ENABLE
+        latency_matrix_changed();
+#endif
 #ifdef DEBUG_LED
         // LED flash for debug
         DEBUG_LED_CONFIG;
@@ -62,115 +147,70 @@ void keyboard_proc(void)
 #endif
     }
 
-    if (matrix_has_ghost()) {
-        // should send error?
-        debug("matrix has ghost!!\n");
-        return;
-    }
+    scan_events(ghost);
 
-    host_swap_keyboard_report();
-    host_clear_keyboard_report();
-    for (int row = 0; row < matrix_rows(); row++) {
-        for (int col = 0; col < matrix_cols(); col++) {
-            if (!matrix_is_on(row, col)) continue;
-
-            uint8_t code = layer_get_keycode(row, col);
-            if (code == KB_NO) {
-                // do nothing
-            } else if (IS_MOD(code)) {
-                host_add_mod_bit(MOD_BIT(code));
-            } else if (IS_FN(code)) {
-                fn_bits |= FN_BIT(code);
-            }
-// TODO: use table or something
-#ifdef EXTRAKEY_ENABLE
-            // System Control
-            else if (code == KB_SYSTEM_POWER) {
-#ifdef HOST_PJRC
-                if (suspend && remote_wakeup) {
-                    usb_remote_wakeup();
-                } else {
-                    host_system_send(SYSTEM_POWER_DOWN);
-                }
-#else
-                host_system_send(SYSTEM_POWER_DOWN);
-#endif
-                host_system_send(0);
-                _delay_ms(500);
-            } else if (code == KB_SYSTEM_SLEEP) {
-                host_system_send(SYSTEM_SLEEP);
-                host_system_send(0);
-                _delay_ms(500);
-            } else if (code == KB_SYSTEM_WAKE) {
-                host_system_send(SYSTEM_WAKE_UP);
-                host_system_send(0);
-                _delay_ms(500);
-            }
-            // Consumer Page
-            else if (code == KB_AUDIO_MUTE) {
-                consumer_code = AUDIO_MUTE;
-            } else if (code == KB_AUDIO_VOL_UP) {
-                consumer_code = AUDIO_VOL_UP;
-            } else if (code == KB_AUDIO_VOL_DOWN) {
-                consumer_code = AUDIO_VOL_DOWN;
-            }
-            else if (code == KB_MEDIA_NEXT_TRACK) {
-                consumer_code = TRANSPORT_NEXT_TRACK;
-            } else if (code == KB_MEDIA_PREV_TRACK) {
-                consumer_code = TRANSPORT_PREV_TRACK;
-            } else if (code == KB_MEDIA_STOP) {
-                consumer_code = TRANSPORT_STOP;
-            } else if (code == KB_MEDIA_PLAY_PAUSE) {
-                consumer_code = TRANSPORT_PLAY_PAUSE;
-            } else if (code == KB_MEDIA_SELECT) {
-                consumer_code = AL_CC_CONFIG;
-            }
-            else if (code == KB_MAIL) {
-                consumer_code = AL_EMAIL;
-            } else if (code == KB_CALCULATOR) {
-                consumer_code = AL_CALCULATOR;
-            } else if (code == KB_MY_COMPUTER) {
-                consumer_code = AL_LOCAL_BROWSER;
-            }
-            else if (code == KB_WWW_SEARCH) {
-                consumer_code = AC_SEARCH;
-            } else if (code == KB_WWW_HOME) {
-                consumer_code = AC_HOME;
-            } else if (code == KB_WWW_BACK) {
-                consumer_code = AC_BACK;
-            } else if (code == KB_WWW_FORWARD) {
-                consumer_code = AC_FORWARD;
-            } else if (code == KB_WWW_STOP) {
-                consumer_code = AC_STOP;
-            } else if (code == KB_WWW_REFRESH) {
-                consumer_code = AC_REFRESH;
-            } else if (code == KB_WWW_FAVORITES) {
-                consumer_code = AC_BOOKMARKS;
-            }
-#endif
-            else if (IS_KEY(code)) {
-                host_add_key(code);
+    // Fn keys pending tap/hold turn into hold before other keys pressed now are looked up
+    if (fn_bits) {
+        for (uint8_t i = 0; i < events_count; i++) {
+            if (events[i].pressed && !IS_FN(layer_get_keycode(events[i].row, events[i].col))) {
+                layer_key_pressed();
+                break;
             }
+        }
+    }
+
+    /*
+     * Report is updated only with keys changed in this scan. Whole matrix
+     * is looked up again when keycode of held keys can vary: Fn and mouse
+     * keys are processed on every scan and layer change remaps held keys.
+     * Keys which didn't fit in report or share keycode with another key
+     * are also found out from matrix again.
+     */
+    bool report_updated = true;
+    if (need_rebuild || events_overflow || fn_bits || dup_keys || host_has_rollover() ||
 #ifdef MOUSEKEY_ENABLE
-            else if (IS_MOUSEKEY(code)) {
-                mousekey_decode(code);
-            }
+            mousekey_held ||
 #endif
-            else {
-                debug("ignore keycode: "); debug_hex(code); debug("\n");
+            current_layer != last_layer) {
+        rebuild_report();
+    } else if (events_count) {
+        host_swap_keyboard_report();
+        host_copy_keyboard_report();
+        for (uint8_t i = 0; i < events_count; i++) {
+            uint8_t code = layer_get_keycode(events[i].row, events[i].col);
+            if (events[i].pressed) {
+                register_code(code);
+            } else {
+                unregister_code(code);
             }
         }
+    } else {
+        report_updated = false;
     }
 
     layer_switching(fn_bits);
+    last_layer = current_layer;
+
+#ifdef EXTRAKEY_ENABLE
+    system_task();
+#endif
 
     if (command_proc()) {
+        // command may clear report
+        need_rebuild = true;
+#ifdef LATENCY_ENABLE
+        latency_no_report();
+#endif
         return;
     }
 
-    // TODO: should send only when changed from last report
-    if (matrix_is_modified()) {
-        host_send_keyboard_report();
+    // report can change without matrix change(Fn hold mods, mouse keys, layer)
+    // host doesn't send report identical to last one, which is counted
+    // only for key changes since rebuild on every scan also comes here
+    if (report_updated) {
+        if (!host_send_keyboard_report() && (events_count || events_overflow)) {
+            keyboard_report_suppressed++;
+        }
 #ifdef EXTRAKEY_ENABLE
         host_consumer_send(consumer_code);
 #endif
@@ -181,6 +221,13 @@ void keyboard_proc(void)
 #endif
     }
 
+#ifdef LATENCY_ENABLE
+    // change is measured until its report is sent unless it waits for nothing
+    if (!ghost && !layer_fn_pending()) {
+        latency_no_report();
+    }
+#endif
+
 #ifdef MOUSEKEY_ENABLE
     mousekey_send();
 #endif
@@ -201,3 +248,171 @@ void keyboard_set_leds(uint8_t leds)
 {
     led_set(leds);
 }
+
+#ifdef EXTRAKEY_ENABLE
+void keyboard_system_tap(uint16_t usage)
+{
+    system_tap = usage;
+}
+#endif
+
+/* make events from rows changed since last scan */
+static void scan_events(bool ghost)
+{
+    uint16_t time = timer_read();
+
+    events_count = 0;
+    events_overflow = false;
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t state = matrix_get_row(row);
+#ifdef MATRIX_HAS_GHOST
+        if (ghost) {
+            // ambiguous keys are not changed until they can be told from ghost
+            matrix_row_t ambiguous = matrix_ghost_row(row);
+            state = (state & ~ambiguous) | (matrix_prev[row] & ambiguous);
+        }
+#endif
+        matrix_row_t change = state ^ matrix_prev[row];
+        if (!change) continue;
+
+        for (uint8_t col = 0; change; col++, change >>= 1) {
+            if (!(change & 1)) continue;
+            if (events_count < KEYEVENT_BUFFER_SIZE) {
+                events[events_count].row = row;
+                events[events_count].col = col;
+                events[events_count].pressed = (state>>col) & 1;
+                events[events_count].time = time;
+                events_count++;
+            } else {
+                events_overflow = true;
+            }
+        }
+        matrix_prev[row] = state;
+    }
+}
+
+/* build report from all keys on matrix as seen by scan_events() */
+static void rebuild_report(void)
+{
+    fn_bits = 0;
+    dup_keys = 0;
+#ifdef MOUSEKEY_ENABLE
+    mousekey_held = 0;
+#endif
+#ifdef EXTRAKEY_ENABLE
+    consumer_keys = 0;
+    consumer_code = 0;
+    system_code = 0;
+#endif
+    need_rebuild = false;
+
+    host_swap_keyboard_report();
+    host_clear_keyboard_report();
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        matrix_row_t state = matrix_prev[row];
+        for (uint8_t col = 0; state; col++, state >>= 1) {
+            if (state & 1) {
+                register_code(layer_get_keycode(row, col));
+            }
+        }
+    }
+}
+
+static void register_code(uint8_t code)
+{
+    if (code == KB_NO) {
+        // do nothing
+    } else if (IS_MOD(code)) {
+        if (keyboard_report->mods & MOD_BIT(code)) dup_keys++;
+        host_add_mod_bit(MOD_BIT(code));
+    } else if (IS_FN(code)) {
+        fn_bits |= FN_BIT(code);
+    }
+#ifdef EXTRAKEY_ENABLE
+    else if (IS_SYSTEM(code)) {
+        // reported by system_task()
+        if (system_code) dup_keys++;
+        system_code = EXTRAKEY_USAGE(code);
+    } else if (IS_CONSUMER(code)) {
+        if (consumer_keys & CONSUMER_BIT(code)) dup_keys++;
+        consumer_keys |= CONSUMER_BIT(code);
+        consumer_code = EXTRAKEY_USAGE(code);
+    }
+#endif
+    else if (IS_KEY(code)) {
+        if (host_has_key(code)) dup_keys++;
+        host_add_key(code);
+    }
+#ifdef MOUSEKEY_ENABLE
+    else if (IS_MOUSEKEY(code)) {
+        mousekey_decode(code);
+        mousekey_held++;
+    }
+#endif
+    else {
+        debug("ignore keycode: "); debug_hex(code); debug("\n");
+    }
+}
+
+static void unregister_code(uint8_t code)
+{
+    if (code == KB_NO) {
+        // do nothing
+    } else if (IS_MOD(code)) {
+        host_del_mod_bit(MOD_BIT(code));
+    } else if (IS_FN(code)) {
+        fn_bits &= ~FN_BIT(code);
+    } else if (IS_KEY(code)) {
+        host_del_key(code);
+    }
+#ifdef EXTRAKEY_ENABLE
+    else if (IS_SYSTEM(code)) {
+        system_code = 0;
+    } else if (IS_CONSUMER(code)) {
+        // fall back to one of consumer keys still held down
+        consumer_keys &= ~CONSUMER_BIT(code);
+        if (consumer_code == EXTRAKEY_USAGE(code)) {
+            consumer_code = 0;
+            for (uint8_t c = KB_AUDIO_MUTE; consumer_keys && c <= KB_WWW_FAVORITES; c++) {
+                if (consumer_keys & CONSUMER_BIT(c)) {
+                    consumer_code = EXTRAKEY_USAGE(c);
+                    break;
+                }
+            }
+        }
+    }
+#endif
+}
+
+#ifdef EXTRAKEY_ENABLE
+/*
+ * Reports system usage without blocking scan: usage is sent on press and
+ * released after the key is released and SYSTEM_TAP_TERM has passed.
+ */
+static void system_task(void)
+{
+    uint16_t code = (system_code ? system_code : system_tap);
+
+    if (code == system_sent) {
+        if (system_tap && timer_elapsed(system_timer) >= SYSTEM_TAP_TERM) {
+            system_tap = 0;
+        }
+        return;
+    }
+    if (system_sent && timer_elapsed(system_timer) < SYSTEM_TAP_TERM) {
+        return;
+    }
+
+#ifdef HOST_PJRC
+    if (code == SYSTEM_POWER_DOWN && suspend && remote_wakeup) {
+        usb_remote_wakeup();
+    } else {
+        host_system_send(code);
+    }
+#else
+    host_system_send(code);
+#endif
+    system_sent = code;
+    system_timer = timer_read();
+}
+#endif
@@ -19,10 +19,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define KEYBOARD_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+
+/* key press/release event made from difference of matrix rows */
+typedef struct {
+    uint8_t  row;
+    uint8_t  col;
+    bool     pressed;
+    uint16_t time;
+} keyevent_t;
 
 
 void keyboard_init(void);
 void keyboard_proc(void);
 void keyboard_set_leds(uint8_t leds);
+/* press and release system usage in background */
+void keyboard_system_tap(uint16_t usage);
+
+/* key changes on matrix which made no change of report */
+extern uint16_t keyboard_report_suppressed;
 
 #endif
@@ -31,4 +31,13 @@ uint8_t keymap_fn_layer(uint8_t fn_bits);
 /* keycode to send when release Fn key without using */
 uint8_t keymap_fn_keycode(uint8_t fn_bits);
 
+/* modifiers to hold instead of moving layer during press Fn key(optional) */
+uint8_t keymap_fn_mods(uint8_t fn_bits);
+
+/* tapping term of Fn key in ms(optional) */
+uint16_t keymap_fn_term(uint8_t fn_bits);
+
+/* whether tapping Fn key toggles its layer(optional) */
+bool keymap_fn_toggle(uint8_t fn_bits);
+
 #endif
@@ -0,0 +1,153 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "timer.h"
+#include "print.h"
+#include "latency.h"
+
+
+#define TICKS_TO_US(t)  ((t) * TIMER_PRESCALER / (F_CPU/1000000))
+
+typedef struct {
+    uint16_t ms;
+    uint8_t raw;
+} stamp_t;
+
+static stamp_t scan_start;
+static stamp_t change_start;
+static bool pending = false;
+
+// statistics in us
+static uint16_t count = 0;
+static uint16_t lat_min = UINT16_MAX;
+static uint16_t lat_max = 0;
+static uint32_t lat_sum = 0;
+static uint16_t hist[LATENCY_BINS];
+
+
+/* timer_count and TIMER_RAW at once */
+static stamp_t timestamp(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ms = timer_count;
+    uint8_t raw = TIMER_RAW;
+    if (TIFR0 & (1<<OCF0A)) {
+        // compare match is not serviced yet
+        ms++;
+        raw = TIMER_RAW;
+    }
+    SREG = sreg;
+    return (stamp_t){ .ms = ms, .raw = raw };
+}
+
+/* ticks of TIMER_RAW from a to b, ms part is modulo 2^16 across wrap of timer_count */
+static uint32_t elapsed_ticks(stamp_t a, stamp_t b)
+{
+    uint16_t ms = b.ms - a.ms;
+    return (uint32_t)ms * (TIMER_RAW_TOP + 1) + b.raw - a.raw;
+}
+
+void latency_scan_start(void)
+{
+    scan_start = timestamp();
+}
+
+/* first change not reported yet is measured */
+void latency_matrix_changed(void)
+{
+    if (pending) return;
+    change_start = scan_start;
+    pending = true;
+}
+
+void latency_no_report(void)
+{
+    pending = false;
+}
+
+void latency_report_sent(void)
+{
+    if (!pending) return;
+    pending = false;
+
+    uint32_t us = TICKS_TO_US(elapsed_ticks(change_start, timestamp()));
+    uint16_t lat = (us > UINT16_MAX ? UINT16_MAX : us);
+
+    if (count == UINT16_MAX) {
+        latency_clear();
+    }
+    count++;
+    lat_sum += lat;
+    if (lat < lat_min) lat_min = lat;
+    if (lat > lat_max) lat_max = lat;
+
+    uint16_t bin = lat / LATENCY_BIN_US;
+    hist[bin < LATENCY_BINS ? bin : LATENCY_BINS - 1]++;
+}
+
+void latency_clear(void)
+{
+    count = 0;
+    lat_min = UINT16_MAX;
+    lat_max = 0;
+    lat_sum = 0;
+    for (uint8_t i = 0; i < LATENCY_BINS; i++) {
+        hist[i] = 0;
+    }
+}
+
+/* upper edge of bin which 99% of samples are in */
+static uint16_t p99(void)
+{
+    uint16_t n = (uint32_t)count * 99 / 100;
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i < LATENCY_BINS - 1; i++) {
+        sum += hist[i];
+        if (sum >= n) {
+            uint16_t edge = (i + 1) * LATENCY_BIN_US;
+            return (edge < lat_max ? edge : lat_max);
+        }
+    }
+    return lat_max;
+}
+
+void latency_print(void)
+{
+    print("latency(us) count: "); phex16(count);
+    if (!count) {
+        print("\n");
+        return;
+    }
+    print(" min: "); phex16(lat_min);
+    print(" avg: "); phex16(lat_sum / count);
+    print(" max: "); phex16(lat_max);
+    print(" p99: "); phex16(p99());
+    print("\n");
+
+    // non-empty bins: lower edge of bin and count
+    for (uint8_t i = 0; i < LATENCY_BINS; i++) {
+        if (!hist[i]) continue;
+        phex16(i * LATENCY_BIN_US);
+        if (i == LATENCY_BINS - 1) print("+");
+        print(": "); phex16(hist[i]); print("\n");
+    }
+}
@@ -0,0 +1,50 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/*
+ * Scan-to-report latency benchmark
+ *
+ * Time from start of the scan which found a matrix change until keyboard
+ * report is handed to host driver is measured with TIMER_RAW resolution.
+ * The change is kept until its report is sent even in later scan(ghost, Fn
+ * pending tap/hold), and dropped when it ends up with no report(suppressed
+ * report, command).
+ */
+
+// width of histogram bin in us
+#ifndef LATENCY_BIN_US
+#   define LATENCY_BIN_US   250
+#endif
+// number of histogram bins. last one counts all longer latencies.
+#ifndef LATENCY_BINS
+#   define LATENCY_BINS     32
+#endif
+
+
+void latency_scan_start(void);
+void latency_matrix_changed(void);
+void latency_report_sent(void);
+void latency_no_report(void);
+void latency_clear(void);
+void latency_print(void);
+
+#endif
@@ -24,178 +24,325 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 /*
- * Parameters:
- *     ENTER_DELAY         |=======|
- *     SEND_FN_TERM        |================|
+ * Fn key tap/hold
+ * Each Fn key has its own state and timer. Fn key works as tap keycode
+ * (keymap_fn_keycode) when tapped and as its layer (keymap_fn_layer) or
+ * modifiers (keymap_fn_mods: dual-role modifier) while held down.
  *
- * Fn key processing cases:
- * 1. release Fn after SEND_FN_TERM.
- *     Layer sw         ___________|~~~~~~~~~~~|___
- *     Fn press         ___|~~~~~~~~~~~~~~~~~~~|___
- *     Fn send          ___________________________
+ * 1. tap: release within tapping term.
+ *     Fn press         ___|~~~~|__________
+ *     Fn key send      ________|~|________
+ *     Layer/mods       ___________________
  *
- * 2. release Fn during SEND_FN_TERM.(not layer used)
- *     Layer sw         ___________|~~~~~~|________
- *     Fn press         ___|~~~~~~~~~~~~~~|________
- *     Fn key send      __________________|~|______
- *     other key press  ___________________________
- *     other key send   ___________________________
+ * 2. hold: keep holding over tapping term.
+ *     Fn press         ___|~~~~~~~~~~|____
+ *     Layer/mods       _______|~~~~~~|____
  *
- * 3. release Fn during SEND_FN_TERM.(layer used)
- *     Layer sw         ___________|~~~~~~|________
- *     Fn press         ___|~~~~~~~~~~~~~~|________
- *     Fn key send      ___________________________
- *     Fn send          ___________________________
- *     other key press  _____________|~~|__________
- *     other key send   _____________|~~|__________
+ * 3. press other key within tapping term: hold is decided at once and
+ *    other key is looked up in Fn layer.
+ *     Fn press         ___|~~~~~~~~~~|____
+ *     other key press  ______|~~~|________
+ *     Layer/mods       ______|~~~~~~~|____
  *
- * 4. press other key during ENTER_DELAY.
- *     Layer sw         ___________________________
- *     Fn key press     ___|~~~~~~~~~|_____________
- *     Fn key send      ______|~~~~~~|_____________
- *     other key press  ______|~~~|________________
- *     other key send   _______|~~|________________
+ * 4. press Fn while other key is pressed: Fn key is sent at once.
+ *    (except for dual-role modifier)
+ *     other key press  ~~~~~~~|___________
+ *     Fn press         ___|~~~~~~~~~|_____
+ *     Fn key send      ___|~~~~~~~~~|_____
  *
- * 5. press Fn while press other key.
- *     Layer sw         ___________________________
- *     Fn key press     ___|~~~~~~~~~|_____________
- *     Fn key send      ___|~~~~~~~~~|_____________
- *     other key press  ~~~~~~~|___________________
- *     other key send   ~~~~~~~|___________________
+ * 5. tap and press Fn again within tapping term: Fn key is held(repeat),
+ *    or layer is toggled on/off with TAPPING_TOGGLE taps if keymap_fn_toggle.
+ *     Fn press         ___|~|____|~~~~~~~~
+ *     Fn key send      _____|~|__|~~~~~~~~
  *
- * 6. press Fn twice quickly and keep holding down.(repeat)
- *     Layer sw         ___________________________
- *     Fn key press     ___|~|____|~~~~~~~~~~~~~~~~
- *     Fn key send      _____|~|__|~~~~~~~~~~~~~~~~
+ * Fn key without tap keycode nor toggle switches layer at press with no delay.
+ * Layer of each Fn switched is pushed on layer stack, keycode is looked up
+ * from top of the stack and transparent keycode(KB_TRNS) falls through to
+ * lower layers down to default layer.
  */
 
-// LAYER_ENTER_DELAY: prevent from moving new layer
-#define LAYER_ENTER_DELAY 150
+// TAPPING_TERM: default of keymap_fn_term(ms)
+#ifndef TAPPING_TERM
+#   define TAPPING_TERM 200
+#endif
 
-// LAYER_SEND_FN_TERM: send keycode if release key in this term
-#define LAYER_SEND_FN_TERM 500
+// TAPPING_TOGGLE: number of taps to toggle layer
+#ifndef TAPPING_TOGGLE
+#   define TAPPING_TOGGLE 2
+#endif
+
+
+/*
+ * Keymap cache: keycodes resolved through layer stack are kept in RAM while
+ * layer doesn't change, so lookup is a load from SRAM instead of PROGMEM.
+ * Only rows less than KEYMAP_CACHE_ROWS are cached to save RAM.
+ */
+#ifdef KEYMAP_CACHE_ENABLE
+#   ifndef KEYMAP_CACHE_ROWS
+#       define KEYMAP_CACHE_ROWS MATRIX_ROWS
+#   endif
+static uint8_t keymap_cache[KEYMAP_CACHE_ROWS][MATRIX_COLS];
+static uint8_t cache_layer = 0xFF;
+static uint8_t cache_default_layer = 0xFF;
+#endif
 
 
 uint8_t default_layer = 0;
 uint8_t current_layer = 0;
 
-static bool layer_used = false;
-static uint8_t new_layer(uint8_t fn_bits);
+// tap/hold state of each Fn key
+enum fn_state {
+    FN_IDLE,
+    FN_PENDING,     // pressed and not decided yet
+    FN_HOLD,        // layer or mods is active
+    FN_TAPPED,      // tap keycode was sent
+    FN_REPEAT,      // tap keycode is held down
+};
+static uint8_t fn_state[8];
+static uint8_t fn_taps[8];
+static uint16_t fn_timer[8];
+static uint8_t fn_toggled = 0;
+static uint8_t fn_pending = 0;
+
+// layer stack: one entry at most for each Fn bit
+static uint8_t stack_layer[8];
+static uint8_t stack_fn[8];
+static uint8_t stack_size = 0;
+static uint8_t stack_bits = 0;
+
+static uint8_t resolve_keycode(uint8_t row, uint8_t col);
+static void fn_hold(uint8_t i);
+static void update_layer(void);
+static void layer_stack_set(uint8_t fn_bits);
+static void add_fn_keycodes(uint8_t fn_bits);
+static void send_fn_keycodes(uint8_t fn_bits, uint8_t mods);
+
+
+/* Optional keymap definitions: return 0 when not used. */
+uint8_t keymap_fn_mods(uint8_t fn_bits) __attribute__ ((weak));
+uint8_t keymap_fn_mods(uint8_t fn_bits)
+{
+    return 0;
+}
+
+uint16_t keymap_fn_term(uint8_t fn_bits) __attribute__ ((weak));
+uint16_t keymap_fn_term(uint8_t fn_bits)
+{
+    return TAPPING_TERM;
+}
+
+bool keymap_fn_toggle(uint8_t fn_bits) __attribute__ ((weak));
+bool keymap_fn_toggle(uint8_t fn_bits)
+{
+    return false;
+}
 
 
 uint8_t layer_get_keycode(uint8_t row, uint8_t col)
 {
-    uint8_t code = keymap_get_keycode(current_layer, row, col);
-    // normal key or mouse key
-    if ((IS_KEY(code) || IS_MOUSEKEY(code))) {
-        layer_used = true;
+#ifdef KEYMAP_CACHE_ENABLE
+    if (row < KEYMAP_CACHE_ROWS) {
+        if (cache_layer != current_layer || cache_default_layer != default_layer) {
+            for (uint8_t r = 0; r < KEYMAP_CACHE_ROWS; r++) {
+                for (uint8_t c = 0; c < MATRIX_COLS; c++) {
+                    keymap_cache[r][c] = resolve_keycode(r, c);
+                }
+            }
+            cache_layer = current_layer;
+            cache_default_layer = default_layer;
+        }
+        return keymap_cache[row][col];
     }
-    return code;
+#endif
+    return resolve_keycode(row, col);
+}
+
+void layer_key_pressed(void)
+{
+    if (!fn_pending) return;
+
+    debug("Fn hold(other key pressed): "); debug_bin(fn_pending); debug("\n");
+    for (uint8_t i = 0; i < 8; i++) {
+        if (fn_state[i] == FN_PENDING) {
+            fn_hold(i);
+        }
+    }
+    update_layer();
 }
 
-// bit substract b from a
-#define BIT_SUBST(a, b) (a&(a^b))
 void layer_switching(uint8_t fn_bits)
 {
-    // layer switching
     static uint8_t last_fn = 0;
-    static uint8_t last_mods = 0;
-    static uint16_t last_timer = 0; 
-    static uint8_t sent_fn = 0;
-
-    if (fn_bits == last_fn) { // Fn state is not changed
-        if (fn_bits == 0) {
-            // do nothing
-        } else {
-            if (timer_elapsed(last_timer) > LAYER_ENTER_DELAY) {
-                uint8_t _layer_to_switch = new_layer(BIT_SUBST(fn_bits, sent_fn));
-                if (current_layer != _layer_to_switch) { // not switch layer yet
-                    debug("Fn case: 1,2,3(LAYER_ENTER_DELAY passed)\n");
-                    debug("Switch Layer: "); debug_hex(current_layer);
-                    current_layer = _layer_to_switch;
-                    layer_used = false;
-                    debug(" -> "); debug_hex(current_layer); debug("\n");
-                }
+    uint8_t fn_to_send = 0;
+
+    if (fn_bits != last_fn) {
+        debug("fn_bits: "); debug_bin(fn_bits); debug("\n");
+    }
+    for (uint8_t i = 0; i < 8; i++) {
+        uint8_t bit = 1<<i;
+        uint8_t tap_code = keymap_fn_keycode(bit);
+
+        if ((fn_bits & bit) && !(last_fn & bit)) {
+            // pressed
+            if (fn_state[i] == FN_TAPPED && timer_elapsed(fn_timer[i]) < keymap_fn_term(bit)) {
+                fn_taps[i]++;
             } else {
-                if (host_has_anykey()) { // other keys is pressed
-                    uint8_t _fn_to_send = BIT_SUBST(fn_bits, sent_fn);
-                    if (_fn_to_send) {
-                        debug("Fn case: 4(send Fn before other key pressed)\n");
-                        // send only Fn key first
-                        host_swap_keyboard_report();
-                        host_clear_keyboard_report();
-                        host_set_mods(last_mods);
-                        host_add_code(keymap_fn_keycode(_fn_to_send));   // TODO: do all Fn keys
-                        host_send_keyboard_report();
-                        host_swap_keyboard_report();
-                        sent_fn |= _fn_to_send;
-                    }
-                }
+                fn_taps[i] = 0;
             }
-            // add Fn keys to send
-            //host_add_code(keymap_fn_keycode(fn_bits&sent_fn));  // TODO: do all Fn keys
-        }
-    } else { // Fn state is changed(edge)
-        uint8_t fn_changed = 0;
 
-        debug("fn_bits: "); debug_bin(fn_bits); debug("\n");
-        debug("sent_fn: "); debug_bin(sent_fn); debug("\n");
-        debug("last_fn: "); debug_bin(last_fn); debug("\n");
-        debug("last_mods: "); debug_hex(last_mods); debug("\n");
-        debug("last_timer: "); debug_hex16(last_timer); debug("\n");
-
-        // pressed Fn
-        if ((fn_changed = BIT_SUBST(fn_bits, last_fn))) {
-        debug("fn_changed: "); debug_bin(fn_changed); debug("\n");
-            if (host_has_anykey()) {
-                debug("Fn case: 5(pressed Fn with other key)\n");
-                sent_fn |= fn_changed;
-            } else if (fn_changed & sent_fn) { // pressed same Fn in a row
-                if (timer_elapsed(last_timer) > LAYER_ENTER_DELAY) {
-                    debug("Fn case: 6(not repeat)\n");
-                    // time passed: not repeate
-                    sent_fn &= ~fn_changed;
-                } else {
-                    debug("Fn case: 6(repeat)\n");
-                }
+            if (keymap_fn_toggle(bit) && fn_taps[i] + 1 >= TAPPING_TOGGLE) {
+                debug("Fn toggle: "); debug_hex(i); debug("\n");
+                fn_toggled ^= bit;
+                fn_taps[i] = 0;
+                fn_state[i] = FN_IDLE;
+            } else if (tap_code != KB_NO && !keymap_fn_toggle(bit) &&
+                    (fn_taps[i] || (host_has_anykey() && !keymap_fn_mods(bit)))) {
+                debug("Fn repeat: "); debug_hex(i); debug("\n");
+                fn_state[i] = FN_REPEAT;
+            } else if (tap_code == KB_NO && !keymap_fn_toggle(bit)) {
+                // nothing to tap: no need to wait
+                fn_hold(i);
+            } else {
+                fn_state[i] = FN_PENDING;
+                fn_pending |= bit;
             }
-        }
-        // released Fn
-        if ((fn_changed = BIT_SUBST(last_fn, fn_bits))) {
-        debug("fn_changed: "); debug_bin(fn_changed); debug("\n");
-            if (timer_elapsed(last_timer) < LAYER_SEND_FN_TERM) {
-                if (!layer_used && BIT_SUBST(fn_changed, sent_fn)) {
-                    debug("Fn case: 2(send Fn one shot: released Fn during LAYER_SEND_FN_TERM)\n");
-                    // send only Fn key first
-                    host_swap_keyboard_report();
-                    host_clear_keyboard_report();
-                    host_set_mods(last_mods);
-                    host_add_code(keymap_fn_keycode(fn_changed));   // TODO: do all Fn keys
-                    host_send_keyboard_report();
-                    host_swap_keyboard_report();
-                    sent_fn |= fn_changed;
-                }
+            fn_timer[i] = timer_read();
+        } else if (!(fn_bits & bit) && (last_fn & bit)) {
+            // released
+            if (fn_state[i] == FN_PENDING) {
+                debug("Fn tap: "); debug_hex(i); debug("\n");
+                fn_to_send |= bit;
+                fn_pending &= ~bit;
+                fn_state[i] = FN_TAPPED;
+                fn_timer[i] = timer_read();
+            } else if (fn_state[i] == FN_REPEAT) {
+                fn_state[i] = FN_TAPPED;
+                fn_timer[i] = timer_read();
+            } else if (fn_state[i] != FN_TAPPED) {
+                fn_state[i] = FN_IDLE;
             }
-            debug("Switch Layer(released Fn): "); debug_hex(current_layer);
-            current_layer = new_layer(BIT_SUBST(fn_bits, sent_fn));
-            debug(" -> "); debug_hex(current_layer); debug("\n");
+        } else if (fn_state[i] == FN_PENDING) {
+            if (timer_elapsed(fn_timer[i]) >= keymap_fn_term(bit)) {
+                debug("Fn hold(tapping term passed): "); debug_hex(i); debug("\n");
+                fn_hold(i);
+            }
+        } else if (fn_state[i] == FN_TAPPED) {
+            if (timer_elapsed(fn_timer[i]) >= keymap_fn_term(bit)) {
+                fn_state[i] = FN_IDLE;
+                fn_taps[i] = 0;
+            }
+        }
+
+        if (fn_state[i] == FN_HOLD) {
+            host_add_mod_bit(keymap_fn_mods(bit));
+        }
+    }
+    last_fn = fn_bits;
+
+    // send keycodes of all Fn keys tapped at once in one report
+    if (fn_to_send) {
+        send_fn_keycodes(fn_to_send, keyboard_report->mods);
+    }
+    update_layer();
+
+    // keycodes of Fn keys held after tap
+    for (uint8_t i = 0; i < 8; i++) {
+        if (fn_state[i] == FN_REPEAT) {
+            add_fn_keycodes(1<<i);
         }
+    }
+}
+
+bool layer_fn_pending(void)
+{
+    return fn_pending;
+}
 
-        layer_used = false;
-        last_fn = fn_bits;
-        last_mods = keyboard_report->mods;
-        last_timer = timer_read();
+static void fn_hold(uint8_t i)
+{
+    fn_state[i] = FN_HOLD;
+    fn_pending &= ~(1<<i);
+}
+
+/* keycode on top of layer stack falling through transparent ones */
+static uint8_t resolve_keycode(uint8_t row, uint8_t col)
+{
+    uint8_t code = keymap_get_keycode(current_layer, row, col);
+    if (code == KB_TRNS) {
+        for (int8_t i = stack_size - 2; code == KB_TRNS && i >= 0; i--) {
+            code = keymap_get_keycode(stack_layer[i], row, col);
+        }
+        if (code == KB_TRNS) {
+            code = keymap_get_keycode(default_layer, row, col);
+        }
+        if (code == KB_TRNS) {
+            code = KB_NO;
+        }
     }
-    // send Fn keys
+    return code;
+}
+
+/* layers of Fn keys held without modifiers and toggled on */
+static void update_layer(void)
+{
+    uint8_t bits = fn_toggled;
     for (uint8_t i = 0; i < 8; i++) {
-        if ((sent_fn & fn_bits) & (1<<i)) {
-            host_add_code(keymap_fn_keycode(1<<i));
+        if (fn_state[i] == FN_HOLD && !keymap_fn_mods(1<<i)) {
+            bits |= (1<<i);
+        }
+    }
+    if (bits != stack_bits) {
+        debug("Switch Layer: "); debug_hex(current_layer);
+        layer_stack_set(bits);
+        debug(" -> "); debug_hex(current_layer); debug("\n");
+    }
+}
+
+/* rebuild layer stack with layers of Fn bits, keeping order of pushed ones */
+static void layer_stack_set(uint8_t fn_bits)
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < stack_size; i++) {
+        if (fn_bits & stack_fn[i]) {
+            stack_layer[n] = stack_layer[i];
+            stack_fn[n] = stack_fn[i];
+            n++;
+        }
+    }
+    uint8_t new_bits = fn_bits & ~stack_bits;
+    for (uint8_t i = 0; new_bits; i++, new_bits >>= 1) {
+        if (new_bits & 1) {
+            stack_layer[n] = keymap_fn_layer(1<<i);
+            stack_fn[n] = 1<<i;
+            n++;
+        }
+    }
+    stack_size = n;
+    stack_bits = fn_bits;
+    current_layer = (n ? stack_layer[n - 1] : default_layer);
+#ifdef KEYMAP_CACHE_ENABLE
+    // lower layers may be changed even if top is not
+    cache_layer = 0xFF;
+#endif
+}
+
+static void add_fn_keycodes(uint8_t fn_bits)
+{
+    for (uint8_t i = 0; fn_bits; i++, fn_bits >>= 1) {
+        if (fn_bits & 1) {
+            uint8_t code = keymap_fn_keycode(1<<i);
+            if (code != KB_NO) host_add_code(code);
         }
     }
 }
 
-inline
-static uint8_t new_layer(uint8_t fn_bits)
+/* send keycodes of Fn keys in a report apart from current one */
+static void send_fn_keycodes(uint8_t fn_bits, uint8_t mods)
 {
-    return (fn_bits ? keymap_fn_layer(fn_bits) : default_layer);
+    host_swap_keyboard_report();
+    host_clear_keyboard_report();
+    host_set_mods(mods);
+    add_fn_keycodes(fn_bits);
+    host_send_keyboard_report();
+    host_swap_keyboard_report();
 }
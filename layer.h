@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define LAYER_H 1
 
 #include <stdint.h>
+#include <stdbool.h>
 
 extern uint8_t default_layer;
 extern uint8_t current_layer;
@@ -26,7 +27,13 @@ extern uint8_t current_layer;
 /* return keycode for switch */
 uint8_t layer_get_keycode(uint8_t row, uint8_t col);
 
+/* decide Fn keys pending tap/hold as hold: call before looking up other key pressed */
+void layer_key_pressed(void);
+
 /* process layer switching */
 void layer_switching(uint8_t fn_bits);
 
+/* whether Fn keys pending tap/hold are held */
+bool layer_fn_pending(void);
+
 #endif
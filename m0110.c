@@ -41,6 +41,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <util/delay.h>
 #include "m0110.h"
 #include "debug.h"
+#include "timer.h"
+#include "ring.h"
 
 
 static inline void clock_lo(void);
@@ -55,6 +57,9 @@ static inline uint16_t wait_data_lo(uint16_t us);
 static inline uint16_t wait_data_hi(uint16_t us);
 static inline void idle(void);
 static inline void request(void);
+#ifdef M0110_INT_VECT
+static void cmd_reset(void);
+#endif
 
 
 /*
@@ -213,6 +218,10 @@ uint8_t m0110_error = 0;
 void m0110_init(void)
 {
     uint8_t data;
+#ifdef M0110_INT_VECT
+    M0110_INT_OFF();
+    cmd_reset();
+#endif
     idle();
     _delay_ms(1000);
 
@@ -228,6 +237,14 @@ void m0110_init(void)
     m0110_send(M0110_TEST);
     data = m0110_recv();
     print("m0110_init test: "); phex(data); print("\n");
+
+#ifdef M0110_INT_VECT
+    // release lines for keyboard and start receive by interrupt
+    clock_in();
+    data_in();
+    M0110_INT_INIT();
+    M0110_INT_ON();
+#endif
 }
 
 /*
@@ -301,10 +318,74 @@ uint8_t m0110_inst_recv(void)
     return m0110_recv();
 }
 
+/*
+ Key event decoder
+ Converts raw bytes from keyboard into key codes. Keypad prefix and 'Shift' event are followed by
+ an "instant" command instead of "inquiry" to get the next byte at once, see next_command().
+ After a 'Shift' event the special 'calc' keys (= / * +), which use the same scancodes as the arrow
+ keys, are distinguished by adding 0x60 instead of 0x40 for keypad.
+ Reply to the instant command after 'Shift' is returned as M0110_NULL, which means plain 'Shift' event,
+ while null reply to inquiry is M0110_NONE(no event).
+ */
+static bool pad = false;            // keypad prefix received
+static bool after_shift = false;    // next reply is for instant command after 'Shift' event
+static volatile bool lost = false;  // key sequence was dropped
+
+/*
+ m0110_sequence_lost
+ Returns true once after a key sequence in progress was dropped by reply timeout, so that
+ caller can drop events waiting for the rest of the sequence as well.
+ */
+bool m0110_sequence_lost(void)
+{
+    if (!lost)
+        return false;
+    lost = false;
+    return true;
+}
+
+static uint8_t next_command(void)
+{
+    return (pad || after_shift) ? M0110_INSTANT : M0110_INQUIRY;
+}
+
+static uint8_t decode(uint8_t raw)
+{
+    uint8_t key;
+
+    if (raw == M0110_PAD_CODE) {
+        pad = true;
+        return M0110_NONE;
+    }
+
+    if (raw == 0xFF || raw == M0110_NULL) {
+        key = after_shift ? M0110_NULL : M0110_NONE;
+        pad = false;
+        after_shift = false;
+        return key;
+    }
+
+    key = (raw & 0x80) | ((raw & 0x7F)>>1);
+    if (pad) {
+        // If the scancode is one of the 'calc' keys add 0x60 to the key code
+        if (after_shift && ((raw&0x7F) == 0x05 || (raw&0x7F) == 0x0D || \
+                            (raw&0x7F) == 0x11 || (raw&0x7F) == 0x1B))
+            key |= M0110_ARR_ADD;
+        else                                        // otherwise, add the normal 0x40 for keypad
+            key |= M0110_PAD_ADD;
+    }
+    pad = false;
+    // only one instant command after 'Shift' event
+    after_shift = !after_shift && (key == M0110_SHIFT_DN || key == M0110_SHIFT_UP);
+    return key;
+}
+
+
+#ifndef M0110_INT_VECT
 /*
  m0110_recv_key
- Receive key function. Transmits an "inquiry" command to the keyboard and receives one byte
- in reply.
+ Receive key function. Transmits an "inquiry" command, or "instant" when decoder needs the following
+ byte at once, and receives one byte in reply. Returns M0110_NONE when no key event.
  IMPORTANT: after an "inquiry", the keyboard could take up to 500msec to respond. The Apple
  specification allows the M0110 keyboard up to 250msec to reply, whereas the Macintosh will
  issue a reinitialisation command (0x16) after not receiving a reply for 500msec. It is unclear
@@ -316,52 +397,180 @@ uint8_t m0110_recv_key(void)
 {
     uint8_t key;
 
-    m0110_send(M0110_INQUIRY);
+    do {
+        m0110_send(next_command());
+        key = decode(m0110_recv());
+    } while (pad);
+    return key;
+}
 
-    key = m0110_recv();
+#else
+/*
+ Interrupt driven receive
+ Pin change interrupt of CLOCK line runs command and reply in background: ISR puts command bits
+ on falling edges, reads reply bits on rising edges and issues next command as soon as reply is
+ decoded, so instant command after keypad prefix or 'Shift' goes without waiting for main loop.
+ Key events are stored in a ring buffer, which is single producer(ISR) and single consumer(main
+ loop) like PS/2 one. Polling stops while the buffer is full and main loop restarts it.
+ */
+#ifndef M0110_RXBUF_SIZE
+#   define M0110_RXBUF_SIZE 16
+#endif
+#define M0110_TIMEOUT   500     // ms to wait for reply of inquiry
+
+static volatile ring_stat_t kbuf_stat;
+RING_DEFINE(kbuf, M0110_RXBUF_SIZE, kbuf_stat)
+
+static volatile enum {
+    CMD_IDLE,
+    CMD_SEND,       // ISR is sending command bits
+    CMD_RECV,       // ISR is receiving reply bits
+} cmd_state = CMD_IDLE;
+static volatile uint8_t cmd_bits;
+static volatile uint8_t cmd_data;
+static volatile uint16_t cmd_timer;
 
-    if (key == M0110_PAD_CODE)    // If the reply is the keypad prefix, issue an 'immediate' command
-    {                             // to receive the actual key scancode and add 0x40 to the key code.
-      key = m0110_inst_recv();
-      return ((key & 0x80) | ((key & 0x7F)>>1)) | M0110_PAD_ADD;
-    }
-    else if (key == 0xFF || key == M0110_NULL)    // if the reply is null, return null
-        return M0110_NULL;
-    else                          // and if the reply is a normal key, return a normal key code
-        return (key & 0x80) | ((key & 0x7F)>>1);
+/*
+ Lines are inputs with pull-up while ISR runs, so they are read without
+ the settling delay of clock_in()/data_in().
+ */
+static inline bool clock_pin(void)
+{
+    return M0110_CLOCK_PIN & M0110_CLOCK_SET;
+}
+static inline bool data_pin(void)
+{
+    return M0110_DATA_PIN & M0110_DATA_SET;
+}
+static inline void data_release(void)
+{
+    M0110_DATA_PORT |= M0110_DATA_SET;
+    M0110_DATA_DDR  &= M0110_DATA_CLR;
 }
 
 /*
- m0110_inst_key
- Instant key receive function. Transmits an "instant" command to the keyboard and receives one byte
- in reply.
- Filters the received scancode through the same criteria as the recv_key but also differentiates
- between the numerical keypad keys and the special 'calc' keys (= / * +) which use the same scancodes
- as the arrow keys.
- This function is only called after a 'shift' key event.
+ Last command bit is held 100us after its rising edge. Compare B of Timer0,
+ which counts 1ms for timer.c, releases DATA so that ISR doesn't wait for it.
+ First edge of reply also releases DATA in case the compare is late.
  */
-uint8_t m0110_inst_key(void)
+#define HOLD_TICKS  (TIMER_RAW_FREQ/10000 + 1)
+
+static inline void hold_start(void)
 {
-    uint8_t key;
+    uint16_t t = TIMER_RAW + HOLD_TICKS;
+    if (t > TIMER_RAW_TOP) t -= TIMER_RAW_TOP + 1;
+    OCR0B = t;
+    TIFR0 = (1<<OCF0B);
+    TIMSK0 |= (1<<OCIE0B);
+}
+static inline void hold_end(void)
+{
+    TIMSK0 &= ~(1<<OCIE0B);
+    data_release();
+}
+
+ISR(TIMER0_COMPB_vect)
+{
+    hold_end();
+}
+
+/* stop command and forget partial key sequence */
+static void cmd_reset(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    hold_end();
+    lost = true;
+    pad = false;
+    after_shift = false;
+    cmd_state = CMD_IDLE;
+    SREG = sreg;
+}
 
-    key = m0110_inst_recv();
+/* request to send: keyboard starts clock, called with interrupt disabled */
+static inline void cmd_start(uint8_t cmd)
+{
+    cmd_data = cmd;
+    cmd_bits = 0;
+    cmd_timer = timer_read();
+    cmd_state = CMD_SEND;
+    data_lo();
+}
 
-    if (key == M0110_PAD_CODE)    // If the reply is the keypad prefix, issue an 'immediate' command
-    {                             // to receive the actual key scancode and...
-      key = m0110_inst_recv();
+/*
+ m0110_recv_key
+ Non-blocking receive key function. Returns key event received by interrupt or M0110_NONE.
+ Starts polling if it is stopped and recovers from lost reply after M0110_TIMEOUT.
+ */
+uint8_t m0110_recv_key(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    if (cmd_state != CMD_IDLE && timer_elapsed(cmd_timer) > M0110_TIMEOUT) {
+        debug("m0110 timeout: "); debug_hex(cmd_state); debug("\n");
+        m0110_error = cmd_state;
+        cmd_reset();
+    }
+    if (cmd_state == CMD_IDLE && !kbuf_full()) {
+        cmd_start(next_command());
+    }
+    SREG = sreg;
 
-   // If the scancode is one of the 'calc' keys add 0x60 to the key code
-      if ((key&0x7F) == 0x05 || (key&0x7F) == 0x0D || \
-          (key&0x7F) == 0x11 || (key&0x7F) == 0x1B)
-        return ((key & 0x80) | ((key & 0x7F)>>1)) | M0110_ARR_ADD;
-      else                                                  // otherwise, add the normal 0x40 for keypad
-        return ((key & 0x80) | ((key & 0x7F)>>1)) | M0110_PAD_ADD;
+    if (kbuf_empty())
+        return M0110_NONE;
+    return kbuf_get();
+}
+
+ISR(M0110_INT_VECT)
+{
+    bool clock = clock_pin();
+
+    switch (cmd_state) {
+        case CMD_SEND:
+            if (!clock) {
+                // falling edge: put bit
+                if (cmd_data & 0x80) {
+                    data_hi();
+                } else {
+                    data_lo();
+                }
+                cmd_data <<= 1;
+            } else if (++cmd_bits == 8) {
+                // rising edge of last bit: hold it and release line for reply
+                hold_start();
+                cmd_bits = 0;
+                cmd_data = 0;
+                cmd_state = CMD_RECV;
+            }
+            break;
+        case CMD_RECV:
+            if (cmd_bits == 0 && (TIMSK0 & (1<<OCIE0B))) {
+                hold_end();
+            }
+            if (clock) {
+                // rising edge: read bit
+                cmd_data <<= 1;
+                if (data_pin()) {
+                    cmd_data |= 1;
+                }
+                if (++cmd_bits == 8) {
+                    uint8_t key = decode(cmd_data);
+                    if (key != M0110_NONE) {
+                        kbuf_put(key);
+                    }
+                    if (kbuf_full()) {
+                        cmd_state = CMD_IDLE;
+                    } else {
+                        cmd_start(next_command());
+                    }
+                }
+            }
+            break;
+        case CMD_IDLE:
+            break;
     }
-    else if (key == 0xFF || key == M0110_NULL)      // if the reply is null, return null
-        return M0110_NULL;
-    else                          // and if the reply is a normal key, return a normal key code
-        return (key & 0x80) | ((key & 0x7F)>>1);
 }
+#endif
 
 /*
  clock_lo
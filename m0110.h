@@ -38,6 +38,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef M0110_H
 #define M0110_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 
 /* port settings for clock and data line */
 #if !(defined(M0110_CLOCK_PORT) && \
@@ -62,6 +65,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define M0110_PAD_CODE    0x79
 #define M0110_OK          0x7D
 #define M0110_NULL        0x7B
+#define M0110_NONE        0xFF  // no key event(m0110_recv_key)
 
 #define M0110_PAD_ADD     0x40
 #define M0110_ARR_ADD     0x60
@@ -82,6 +86,6 @@ uint8_t m0110_send(uint8_t data);
 uint8_t m0110_recv(void);
 uint8_t m0110_inst_recv(void);
 uint8_t m0110_recv_key(void);
-uint8_t m0110_inst_key(void);
+bool m0110_sequence_lost(void);
 
 #endif
@@ -60,4 +60,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define M0110_DATA_DDR          DDRB
 #define M0110_DATA_BIT          1
 
+/* Receive with pin change interrupt of CLOCK line(PB0: PCINT0)
+ * comment out to poll keyboard with busy-wait in matrix_scan */
+#define M0110_USE_INT
+
+#ifdef M0110_USE_INT
+#define M0110_INT_INIT()  do {  \
+    PCICR  |= (1<<PCIE0);       \
+} while (0)
+#define M0110_INT_ON()  do {    \
+    PCMSK0 |= (1<<PCINT0);      \
+} while (0)
+#define M0110_INT_OFF() do {    \
+    PCMSK0 &= ~(1<<PCINT0);     \
+} while (0)
+#define M0110_INT_VECT  PCINT0_vect
+#endif
+
 #endif
@@ -40,14 +40,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 static bool is_modified = false;
+static uint8_t shift_key = M0110_NONE;  // 'Shift' event waiting for the next event
 
 // matrix state buffer(1:on, 0:off)
 static uint8_t *matrix;
 static uint8_t _matrix0[MATRIX_ROWS];
 
-#ifdef MATRIX_HAS_GHOST
-static bool matrix_has_ghost_in_row(uint8_t row);
-#endif
 static void register_key(uint8_t key);
 
 
@@ -73,6 +71,7 @@ void matrix_init(void)
     print("debug enabled.\n");
 
     m0110_init();
+    shift_key = M0110_NONE;
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix0[i] = 0x00;
     matrix = _matrix0;
@@ -82,8 +81,10 @@ void matrix_init(void)
 /*
  matrix_scan
  Basic function to report any key events.
- Requests a report from the keyboard, tries to resolve the source of any 'Shift' plus keypad/arrow
+ Takes a key event from the keyboard, tries to resolve the source of any 'Shift' plus keypad/arrow
  events and registers keyboard events to the matrix.
+ A 'Shift' event is held until the next event comes, which is the reply to the instant command
+ issued after 'Shift', so that no scan waits for the keyboard.
  */
 uint8_t matrix_scan(void)
 {
@@ -92,6 +93,11 @@ uint8_t matrix_scan(void)
     is_modified = false;
     key = m0110_recv_key();
 
+    // 'Shift' event waiting for the reply which was lost
+    if (m0110_sequence_lost()) {
+        shift_key = M0110_NONE;
+    }
+
 #ifdef MATRIX_HAS_LOCKING_CAPS
     // Send Caps key up event
     if (matrix_is_on(ROW(CAPS), COL(CAPS))) {
@@ -99,14 +105,15 @@ uint8_t matrix_scan(void)
         register_key(CAPS_UP);
     }
 #endif
-    if (key == M0110_NULL)      // If the key event is null, return with no event
+    if (key == M0110_NONE)      // If there is no key event, return with no event
     {
         return 0;
     }
-    else if (key == M0110_SHIFT_DN || key == M0110_SHIFT_UP)    // If there is a 'Shift' event, request
-    {                                                            // a new instant response from the keyboard,
-                                                                 // in case it's a 'calc' key sequence.
-      keyaux = m0110_inst_key();
+    else if (shift_key != M0110_NONE)   // If there is a pending 'Shift' event, this is the reply to
+    {                                   // the instant command, in case it's a 'calc' key sequence.
+      keyaux = key;
+      key = shift_key;
+      shift_key = M0110_NONE;
 
       is_modified = true;
 
@@ -135,7 +142,7 @@ uint8_t matrix_scan(void)
        // with the same scancode is registered as pressed, then we understand that we've got a simultaneous
        // shift-arrow release; then readjust the received key code to 'arrow' (0x40) instead of 'calc' (0x60)
        // (i.e. subtract 0x20)
-          if (keyaux&0xE0 == 0xE0)        // If event is release; quick check before matrix check
+          if ((keyaux&0xE0) == 0xE0)      // If event is release; quick check before matrix check
             if (!matrix_is_on(ROW(keyaux), COL(keyaux)) && \
                 matrix_is_on(ROW(keyaux&0xDF), COL(keyaux&0xDF)))
                 keyaux &= 0xDF;
@@ -149,6 +156,11 @@ uint8_t matrix_scan(void)
             register_key(key);
       }
     }
+    else if (key == M0110_SHIFT_DN || key == M0110_SHIFT_UP)    // If there is a 'Shift' event, wait for
+    {                                                            // the reply to the instant command.
+        shift_key = key;
+        return 0;
+    }
     else              // In any other case, move on for the final check
     {
 #ifdef MATRIX_HAS_LOCKING_CAPS    
@@ -193,12 +205,10 @@ inline
 bool matrix_has_ghost(void)
 {
 #ifdef MATRIX_HAS_GHOST
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        if (matrix_has_ghost_in_row(i))
-            return true;
-    }
-#endif
+    return matrix_ghost_update();
+#else
     return false;
+#endif
 }
 
 inline
@@ -232,23 +242,6 @@ uint8_t matrix_key_count(void)
     return count;
 }
 
-#ifdef MATRIX_HAS_GHOST
-inline
-static bool matrix_has_ghost_in_row(uint8_t row)
-{
-    // no ghost exists in case less than 2 keys on
-    if (((matrix[row] - 1) & matrix[row]) == 0)
-        return false;
-
-    // ghost exists in case same state as other row
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) {
-        if (i != row && (matrix[i] & matrix[row]) == matrix[row])
-            return true;
-    }
-    return false;
-}
-#endif
-
 inline
 static void register_key(uint8_t key)
 {
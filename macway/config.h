@@ -33,8 +33,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MATRIX_COLS 8
 /* define if matrix has ghost */
 #define MATRIX_HAS_GHOST
-/* Set 0 if need no debouncing */
+/* debounce time in ms. Set 0 if need no debouncing */
 #define DEBOUNCE    5
+/* report key at once and ignore its bounce(see matrix.h) */
+#define DEBOUNCE_TYPE   DEBOUNCE_EAGER
 
 
 /* key combination for command */
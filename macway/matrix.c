@@ -36,27 +36,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 
-#ifndef DEBOUNCE
-#   define DEBOUNCE	0
-#endif
-static uint8_t debouncing = DEBOUNCE;
-
 // matrix state buffer(1:on, 0:off)
-#if (MATRIX_COLS <= 8)
-static uint8_t *matrix;
-static uint8_t *matrix_prev;
-static uint8_t _matrix0[MATRIX_ROWS];
-static uint8_t _matrix1[MATRIX_ROWS];
-#else
-static uint16_t *matrix;
-static uint16_t *matrix_prev;
-static uint16_t _matrix0[MATRIX_ROWS];
-static uint16_t _matrix1[MATRIX_ROWS];
-#endif
+static matrix_row_t matrix[MATRIX_ROWS];
+static matrix_row_t matrix_raw[MATRIX_ROWS];
+static bool modified = false;
 
-#ifdef MATRIX_HAS_GHOST
-static bool matrix_has_ghost_in_row(uint8_t row);
-#endif
 static uint8_t read_col(void);
 static void unselect_rows(void);
 static void select_row(uint8_t row);
@@ -83,62 +67,38 @@ void matrix_init(void)
     PORTB = 0xFF;
 
     // initialize matrix state: all keys off
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix0[i] = 0x00;
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) _matrix1[i] = 0x00;
-    matrix = _matrix0;
-    matrix_prev = _matrix1;
+    for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix[i] = 0x00;
+    for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix_raw[i] = 0x00;
+    debounce_init();
 }
 
 uint8_t matrix_scan(void)
 {
-    if (!debouncing) {
-        uint8_t *tmp = matrix_prev;
-        matrix_prev = matrix;
-        matrix = tmp;
-    }
-
     for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
         unselect_rows();
         select_row(i);
         _delay_us(30);  // without this wait read unstable value.
-        if (matrix[i] != (uint8_t)~read_col()) {
-            matrix[i] = (uint8_t)~read_col();
-            if (debouncing) {
-                debug("bounce!: "); debug_hex(debouncing); print("\n");
-            }
-            debouncing = DEBOUNCE;
-        }
+        matrix_raw[i] = (uint8_t)~read_col();
     }
     unselect_rows();
 
-    if (debouncing) {
-        debouncing--;
-    }
-
+    modified = debounce(matrix_raw, matrix);
     return 1;
 }
 
 bool matrix_is_modified(void)
 {
-    if (debouncing) return false;
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        if (matrix[i] != matrix_prev[i]) {
-            return true;
-        }
-    }
-    return false;
+    return modified;
 }
 
 inline
 bool matrix_has_ghost(void)
 {
 #ifdef MATRIX_HAS_GHOST
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        if (matrix_has_ghost_in_row(i))
-            return true;
-    }
-#endif
+    return matrix_ghost_update();
+#else
     return false;
+#endif
 }
 
 inline
@@ -148,11 +108,7 @@ bool matrix_is_on(uint8_t row, uint8_t col)
 }
 
 inline
-#if (MATRIX_COLS <= 8)
-uint8_t matrix_get_row(uint8_t row)
-#else
-uint16_t matrix_get_row(uint8_t row)
-#endif
+matrix_row_t matrix_get_row(uint8_t row)
 {
     return matrix[row];
 }
@@ -168,7 +124,7 @@ void matrix_print(void)
         pbin_reverse16(matrix_get_row(row));
 #endif
 #ifdef MATRIX_HAS_GHOST
-        if (matrix_has_ghost_in_row(row)) {
+        if (matrix_ghost_row(row)) {
             print(" <ghost");
         }
 #endif
@@ -189,23 +145,6 @@ uint8_t matrix_key_count(void)
     return count;
 }
 
-#ifdef MATRIX_HAS_GHOST
-inline
-static bool matrix_has_ghost_in_row(uint8_t row)
-{
-    // no ghost exists in case less than 2 keys on
-    if (((matrix[row] - 1) & matrix[row]) == 0)
-        return false;
-
-    // ghost exists in case same state as other row
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) {
-        if (i != row && (matrix[i] & matrix[row]) == matrix[row])
-            return true;
-    }
-    return false;
-}
-#endif
-
 inline
 static uint8_t read_col(void)
 {
@@ -18,8 +18,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include <stdint.h>
 #include <stdbool.h>
 
+
+#if (MATRIX_COLS <= 8)
+typedef uint8_t     matrix_row_t;
+#else
+typedef uint16_t    matrix_row_t;
+#endif
+
 /* number of matrix rows */
 uint8_t matrix_rows(void);
 /* number of matrix columns */
@@ -35,15 +43,37 @@ bool matrix_has_ghost(void);
 /* whether a swtich is on */
 bool matrix_is_on(uint8_t row, uint8_t col);
 /* matrix state on row */
-#if (MATRIX_COLS <= 8)
-uint8_t matrix_get_row(uint8_t row);
-#else
-uint16_t matrix_get_row(uint8_t row);
-#endif
+matrix_row_t matrix_get_row(uint8_t row);
 /* count keys pressed */
 uint8_t matrix_key_count(void);
 /* print matrix for debug */
 void matrix_print(void);
 
 
+/*
+ * Ghost detection(ghost.c) for matrix without diodes(MATRIX_HAS_GHOST)
+ * matrix_has_ghost() of scan driver calls matrix_ghost_update().
+ */
+/* find keys which may be ghost on current matrix. return true when any. */
+bool matrix_ghost_update(void);
+/* keys on row which may be ghost, found by last matrix_ghost_update() */
+matrix_row_t matrix_ghost_row(uint8_t row);
+
+
+/*
+ * Debounce(debounce.c) for scan drivers
+ * DEBOUNCE is time in ms(7 at most for per-key, 0 for no debouncing) and DEBOUNCE_TYPE selects algorithm:
+ *   DEBOUNCE_SYM:      whole matrix is updated after no change for DEBOUNCE
+ *   DEBOUNCE_EAGER:    change of key is reported at once, then the key is ignored for DEBOUNCE
+ *   DEBOUNCE_DEFER:    change of key is reported after the key is stable for DEBOUNCE
+ */
+#define DEBOUNCE_SYM    0
+#define DEBOUNCE_EAGER  1
+#define DEBOUNCE_DEFER  2
+
+void debounce_init(void);
+/* update cooked rows with raw rows read in this scan. return true when cooked is changed. */
+bool debounce(matrix_row_t raw[], matrix_row_t cooked[]);
+
+
 #endif
@@ -12,7 +12,7 @@ VPATH += $(COMMON_DIR):$(COMMON_DIR)/pjrc
 
 
 # Option modules
-ifdef $(or MOUSEKEY_ENABLE, PS2_MOUSE_ENABLE)
+ifneq ($(MOUSEKEY_ENABLE)$(PS2_MOUSE_ENABLE)$(ADB_MOUSE_ENABLE),)
     SRC += usb_mouse.c
 endif
 
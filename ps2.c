@@ -41,6 +41,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <util/delay.h>
 #include "ps2.h"
 #include "debug.h"
+#include "timer.h"
+#include "ring.h"
 
 
 static uint8_t recv_data(void);
@@ -97,11 +99,15 @@ void ps2_host_init(void)
 #endif
 }
 
-// TODO: send using interrupt if available
+/* send a byte and receive response, blocking. see ps2_host_queue() also. */
 uint8_t ps2_host_send(uint8_t data)
 {
     uint8_t res = 0;
     bool parity = true;
+#ifdef PS2_INT_VECT
+    // bytes queued go first
+    ps2_host_flush();
+#endif
     ps2_error = PS2_ERR_NONE;
 #ifdef PS2_INT_DISABLE
     PS2_INT_DISABLE();
@@ -179,53 +185,205 @@ uint8_t ps2_host_recv(void)
     return ps2_host_recv_response();
 }
 #else
-/* ring buffer to store ps/2 key data */
-#define PBUF_SIZE 8
-static uint8_t pbuf[PBUF_SIZE];
-static uint8_t pbuf_head = 0;
-static uint8_t pbuf_tail = 0;
-static inline void pbuf_enqueue(uint8_t data)
+#if !(defined(PS2_INT_ENABLE) && defined(PS2_INT_DISABLE))
+#   error "PS2_INT_ENABLE() and PS2_INT_DISABLE() are required in config.h with PS2_INT_VECT"
+#endif
+/* NOTE: PS2_INT_ENABLE() should clear pending interrupt flag before enabling,
+ * falling edge of clock by host itself(inhibit) must not be taken as from device. */
+
+/* Ring buffer to store ps/2 key data */
+#ifndef PS2_RXBUF_SIZE
+#   define PS2_RXBUF_SIZE   32
+#endif
+volatile ring_stat_t ps2_rx_stat;
+RING_DEFINE(pbuf, PS2_RXBUF_SIZE, ps2_rx_stat)
+
+volatile uint16_t ps2_rx_parity_error = 0;
+
+/*
+ * Transmit driven by clock interrupt
+ * Bytes queued with ps2_host_queue() are sent one by one from main loop
+ * context(ps2_host_recv/queue/flush). Host only holds clock low 100us and
+ * pulls data low, then ISR puts bits on falling edges of clock from device.
+ * Response from device is taken by receive ISR: ACK finishes the byte and
+ * RESEND sends it again, other data go to receive buffer as usual. RESEND
+ * sent by host is answered with data retransmitted, which finishes it.
+ */
+#ifndef PS2_TXBUF_SIZE
+#   define PS2_TXBUF_SIZE   8
+#endif
+#if (PS2_TXBUF_SIZE & (PS2_TXBUF_SIZE - 1))
+#   error "PS2_TXBUF_SIZE must be power of 2"
+#endif
+#define TX_TIMEOUT  20      // ms to wait for clock or response from device
+#define TX_RETRY    3
+
+static uint8_t txbuf[PS2_TXBUF_SIZE];
+static uint8_t txbuf_head = 0;
+static uint8_t txbuf_tail = 0;
+
+static volatile enum {
+    TX_IDLE,
+    TX_BITS,        // ISR is sending bits
+    TX_RESPONSE,    // waiting for response
+    TX_DONE,        // ACK received
+} tx_state = TX_IDLE;
+static volatile uint8_t tx_data;
+static volatile uint8_t tx_bit;
+static volatile uint8_t tx_parity;
+static uint8_t tx_retry = 0;
+static uint16_t tx_timer;
+
+static volatile uint8_t rx_state = 0;
+static volatile bool rx_error = false;   // receive failed: ask device to resend
+
+
+static void tx_start(void)
 {
-    if (!data)
-        return;
-
-    uint8_t sreg = SREG;
-    cli();
-    uint8_t next = (pbuf_head + 1) % PBUF_SIZE;
-    if (next != pbuf_tail) {
-        pbuf[pbuf_head] = data;
-        pbuf_head = next;
-    } else {
-        debug("pbuf: full\n");
-    }
-    SREG = sreg;
+    PS2_INT_DISABLE();
+    /* terminate a transmission if we have */
+    inhibit();
+    _delay_us(100);
+
+    tx_data = txbuf[txbuf_tail];
+    tx_bit = 0;
+    tx_parity = 1;
+    rx_state = 0;
+    tx_state = TX_BITS;
+    tx_timer = timer_read();
+
+    /* start bit: device will clock in bits */
+    data_lo();
+    PS2_INT_ENABLE();   // drops edge latched by inhibit()
+    clock_hi();
+}
+
+static void tx_next(void)
+{
+    txbuf_tail = (txbuf_tail + 1) & (PS2_TXBUF_SIZE - 1);
+    tx_retry = 0;
+    tx_state = TX_IDLE;
 }
-static inline uint8_t pbuf_dequeue(void)
+
+/* proceed transmit: called from main loop */
+static void tx_task(void)
 {
-    uint8_t val = 0;
+    switch (tx_state) {
+        case TX_DONE:
+            tx_next();
+            break;
+        case TX_BITS:
+        case TX_RESPONSE:
+            if (timer_elapsed(tx_timer) > TX_TIMEOUT) {
+                debug("ps2 tx timeout: "); debug_hex(tx_data); debug("\n");
+                uint8_t sreg = SREG;
+                cli();
+                idle();
+                rx_state = 0;
+                tx_next();
+                SREG = sreg;
+            }
+            return;
+        case TX_IDLE:
+            break;
+    }
+
+    // device is not sending
+    if (txbuf_head != txbuf_tail && !rx_state) {
+        if (tx_retry++ < TX_RETRY) {
+            tx_start();
+        } else {
+            tx_next();
+        }
+    }
+}
 
-    uint8_t sreg = SREG;
-    cli();
-    if (pbuf_head != pbuf_tail) {
-        val = pbuf[pbuf_tail];
-        pbuf_tail = (pbuf_tail + 1) % PBUF_SIZE;
+/* queue a byte to send. returns false when queue is full. */
+bool ps2_host_queue(uint8_t data)
+{
+    uint8_t next = (txbuf_head + 1) & (PS2_TXBUF_SIZE - 1);
+    if (next == txbuf_tail) {
+        debug("ps2 txbuf: full\n");
+        return false;
     }
-    SREG = sreg;
+    txbuf[txbuf_head] = data;
+    txbuf_head = next;
+    tx_task();
+    return true;
+}
 
-    return val;
+/* wait until all queued bytes are sent */
+void ps2_host_flush(void)
+{
+    while (txbuf_head != txbuf_tail) {
+        tx_task();
+    }
 }
 
 /* get data received by interrupt */
 uint8_t ps2_host_recv(void)
 {
-    if (ps2_error) {
+    if (rx_error) {
         print("x");
         phex(ps2_error);
-        ps2_host_send(0xFE);    // request to resend
+        ps2_host_queue(PS2_RESEND);    // request to resend
         ps2_error = PS2_ERR_NONE;
+        rx_error = false;
+    }
+    tx_task();
+    if (tx_state == TX_IDLE) {
+        idle();
+    }
+    return pbuf_get();
+}
+
+/* falling edge of clock while sending: put next bit */
+static inline void tx_clock(void)
+{
+    tx_bit++;
+    if (tx_bit <= 8) {
+        /* data [2-9] */
+        if (tx_data & (1<<(tx_bit - 1))) {
+            tx_parity++;
+            data_hi();
+        } else {
+            data_lo();
+        }
+    } else if (tx_bit == 9) {
+        /* parity [10] */
+        if (tx_parity & 1) { data_hi(); } else { data_lo(); }
+    } else if (tx_bit == 10) {
+        /* stop bit [11] */
+        data_hi();
+    } else {
+        /* ack [12] */
+        if (data_in()) {
+            /* no ACK: tx_task() sends the byte again */
+            ps2_error = PS2_ERR_TX;
+            tx_state = TX_IDLE;
+        } else {
+            tx_state = TX_RESPONSE;
+        }
     }
-    idle();
-    return pbuf_dequeue();
+}
+
+/* response to byte sent: returns true when it is not data from device */
+static inline bool tx_response(uint8_t data)
+{
+    if (tx_data == PS2_RESEND) {
+        /* device answers RESEND with the byte again instead of ACK */
+        tx_state = TX_DONE;
+        return false;
+    }
+    if (data == PS2_ACK) {
+        tx_state = TX_DONE;
+        return true;
+    }
+    if (data == PS2_RESEND) {
+        tx_state = TX_IDLE;
+        return true;
+    }
+    return false;
 }
 
 #if 0
@@ -237,13 +395,14 @@ uint8_t ps2_host_recv(void)
 #endif
 ISR(PS2_INT_VECT)
 {
-    static enum {
+    enum {
         INIT,
         START,
         BIT0, BIT1, BIT2, BIT3, BIT4, BIT5, BIT6, BIT7,
         PARITY,
         STOP,
-    } state = INIT;
+    };
+    uint8_t state = rx_state;
     static uint8_t data = 0;
     static uint8_t parity = 1;
 
@@ -254,12 +413,19 @@ ISR(PS2_INT_VECT)
         goto RETURN;
     }
 
+    if (tx_state == TX_BITS) {
+        tx_clock();
+        goto RETURN;
+    }
+
     state++;
     DEBUGP(state);
     switch (state) {
         case START:
             if (data_in())
                 goto ERROR;
+            data = 0;
+            parity = 1;
             break;
         case BIT0:
         case BIT1:
@@ -276,18 +442,17 @@ ISR(PS2_INT_VECT)
             }
             break;
         case PARITY:
-            if (data_in()) {
-                if (!(parity & 0x01))
-                    goto ERROR;
-            } else {
-                if (parity & 0x01)
-                    goto ERROR;
+            if (data_in() != (parity & 0x01)) {
+                ps2_rx_parity_error++;
+                goto ERROR;
             }
             break;
         case STOP:
             if (!data_in())
                 goto ERROR;
-            pbuf_enqueue(data);
+            if (tx_state != TX_RESPONSE || !tx_response(data)) {
+                if (data) pbuf_put(data);
+            }
             goto DONE;
             break;
         default:
@@ -298,11 +463,18 @@ ERROR:
     DEBUGP(0x0F);
     inhibit();
     ps2_error = state;
+    if (tx_state == TX_RESPONSE) {
+        /* broken response: tx_task() sends the byte again */
+        tx_state = TX_IDLE;
+    } else {
+        rx_error = true;
+    }
 DONE:
     state = INIT;
     data = 0;
     parity = 1;
 RETURN:
+    rx_state = state;
     return;
 }
 #endif
@@ -316,8 +488,13 @@ static void ps2_reset(void)
 /* send LED state to keyboard */
 void ps2_host_set_led(uint8_t led)
 {
-    ps2_host_send(0xED);
+#ifdef PS2_INT_VECT
+    ps2_host_queue(PS2_SET_LED);
+    ps2_host_queue(led);
+#else
+    ps2_host_send(PS2_SET_LED);
     ps2_host_send(led);
+#endif
 }
 
 
@@ -40,6 +40,9 @@ POSSIBILITY OF SUCH DAMAGE.
 /*
  * Primitive PS/2 Library for AVR
  */
+#include <stdint.h>
+#include <stdbool.h>
+#include "ring.h"
 
 
 /* port settings for clock and data line */
@@ -63,6 +66,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #define PS2_ERR_NONE    0
 #define PS2_ERR_PARITY  0x10
+#define PS2_ERR_TX      0x20
 
 #define PS2_LED_SCROLL_LOCK 0
 #define PS2_LED_NUM_LOCK    1
@@ -77,6 +81,13 @@ uint8_t ps2_host_send(uint8_t data);
 uint8_t ps2_host_recv_response(void);
 uint8_t ps2_host_recv(void);
 void ps2_host_set_led(uint8_t usb_led);
+/* interrupt driven transmit(PS2_INT_VECT) */
+bool ps2_host_queue(uint8_t data);
+void ps2_host_flush(void);
+/* receive buffer statistics(PS2_INT_VECT/PS2_USART_RX_VECT) */
+extern volatile ring_stat_t ps2_rx_stat;
+/* receive error counts(PS2_INT_VECT) */
+extern volatile uint16_t ps2_rx_parity_error;
 
 /* device role */
 
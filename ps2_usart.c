@@ -95,8 +95,14 @@ static inline uint16_t wait_data_lo(uint16_t us);
 static inline uint16_t wait_data_hi(uint16_t us);
 static inline void idle(void);
 static inline void inhibit(void);
-static inline uint8_t pbuf_dequeue(void);
-static inline void pbuf_enqueue(uint8_t data);
+
+
+/* Ring buffer to store scan codes from keyboard */
+#ifndef PS2_RXBUF_SIZE
+#   define PS2_RXBUF_SIZE   8
+#endif
+volatile ring_stat_t ps2_rx_stat;
+RING_DEFINE(pbuf, PS2_RXBUF_SIZE, ps2_rx_stat)
 
 
 void ps2_host_init(void)
@@ -177,7 +183,7 @@ uint8_t ps2_host_recv_response(void)
 
 uint8_t ps2_host_recv(void)
 {
-    return pbuf_dequeue();
+    return pbuf_get();
 }
 
 ISR(PS2_USART_RX_VECT)
@@ -188,7 +194,7 @@ ISR(PS2_USART_RX_VECT)
     if (error) {
         DEBUGP(error>>2);
     } else {
-        pbuf_enqueue(data);
+        if (data) pbuf_put(data);
     }
     DEBUGP(0x8);
 }
@@ -282,43 +288,3 @@ static inline void inhibit(void)
     clock_lo();
     data_hi();
 }
-
-
-/*--------------------------------------------------------------------
- * Ring buffer to store scan codes from keyboard
- *------------------------------------------------------------------*/
-#define PBUF_SIZE 8
-static uint8_t pbuf[PBUF_SIZE];
-static uint8_t pbuf_head = 0;
-static uint8_t pbuf_tail = 0;
-static inline void pbuf_enqueue(uint8_t data)
-{
-    if (!data)
-        return;
-
-    uint8_t sreg = SREG;
-    cli();
-    uint8_t next = (pbuf_head + 1) % PBUF_SIZE;
-    if (next != pbuf_tail) {
-        pbuf[pbuf_head] = data;
-        pbuf_head = next;
-    } else {
-        debug("pbuf: full\n");
-    }
-    SREG = sreg;
-}
-
-static inline uint8_t pbuf_dequeue(void)
-{
-    uint8_t val = 0;
-
-    uint8_t sreg = SREG;
-    cli();
-    if (pbuf_head != pbuf_tail) {
-        val = pbuf[pbuf_tail];
-        pbuf_tail = (pbuf_tail + 1) % PBUF_SIZE;
-    }
-    SREG = sreg;
-
-    return val;
-}
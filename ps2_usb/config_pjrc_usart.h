@@ -29,8 +29,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 /* matrix size */
-#define MATRIX_ROWS 32  // keycode bit: 3-0
-#define MATRIX_COLS 8   // keycode bit: 6-4
+#define MATRIX_ROWS 18  // key number bit: 7-3
+#define MATRIX_COLS 8   // key number bit: 2-0
 
 
 /* key combination for command */
@@ -56,6 +56,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define PS2_DATA_DDR    DDRD
 #define PS2_DATA_BIT    2
 
+/* Scan Code Set 3 with make/break for all keys, falls back to Set 2 */
+//#define PS2_USE_SET3
+
 
 // synchronous, odd parity, 1-bit stop, 8-bit data, sample at falling edge
 // set DDR of CLOCK as input to be slave
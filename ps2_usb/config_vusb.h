@@ -29,8 +29,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 /* matrix size */
-#define MATRIX_ROWS 32  // keycode bit: 3-0
-#define MATRIX_COLS 8   // keycode bit: 6-4
+#define MATRIX_ROWS 18  // key number bit: 7-3
+#define MATRIX_COLS 8   // key number bit: 2-0
 
 
 /* key combination for command */
@@ -66,6 +66,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // Use INT1 or PCINTxx for PS/2 CLOCK line. see below.
 //#define PS2_USE_INT
 
+// Scan Code Set 3 with make/break for all keys, falls back to Set 2
+//#define PS2_USE_SET3
+
 
 #ifdef PS2_USE_USART
 // synchronous, odd parity, 1-bit stop, 8-bit data, sample at falling edge
@@ -102,28 +105,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #ifdef PS2_USE_INT
+/* pending flag is cleared on enable, edge latched while clock is held low is stale */
 /* INT1
-#define PS2_INT_INIT()  do {    \
+#define PS2_INT_ENABLE()  do {  \
     EICRA |= ((1<<ISC11) |      \
               (0<<ISC10));      \
-} while (0)
-#define PS2_INT_ON()  do {      \
+    EIFR = (1<<INTF1);          \
     EIMSK |= (1<<INT1);         \
 } while (0)
-#define PS2_INT_OFF() do {      \
+#define PS2_INT_DISABLE() do {  \
     EIMSK &= ~(1<<INT1);        \
 } while (0)
 #define PS2_INT_VECT    INT1_vect
 */
 
 /* PCINT20 */
-#define PS2_INT_INIT()  do {    \
+#define PS2_INT_ENABLE()  do {  \
+    PCIFR = (1<<PCIF2);         \
     PCICR  |= (1<<PCIE2);       \
-} while (0)
-#define PS2_INT_ON()  do {      \
     PCMSK2 |= (1<<PCINT20);     \
 } while (0)
-#define PS2_INT_OFF() do {      \
+#define PS2_INT_DISABLE() do {  \
     PCMSK2 &= ~(1<<PCINT20);    \
     PCICR  &= ~(1<<PCIE2);      \
 } while (0)
@@ -32,7 +32,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 // Following macros help you to define a keymap with the form of actual keyboard layout.
 
-/* US layout plus all other various keys */
+/* US layout plus all other various keys
+ * Matrix lists keys in order of scan code(E0-prefixed as 80-FF) to match
+ * key_index[] in matrix.c. */
 #define KEYMAP_ALL( \
     K76,K05,K06,K04,K0C,K03,K0B,K83,K0A,K01,K09,K78,K07,     KFC,K7E,KFE,                   \
     K0E,K16,K1E,K26,K25,K2E,K36,K3D,K3E,K46,K45,K4E,K55,K66, KF0,KEC,KFD,  K77,KCA,K7C,K7B, \
@@ -51,38 +53,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     K90, KBA, KB8, KB0,      /* WWW Search, Home, Back, Forward */                          \
     KA8, KA0, K98            /* WWW Stop, Refresh, Favorites */                             \
 ) { \
-    { KB_NO,    KB_##K01, KB_NO,    KB_##K03, KB_##K04, KB_##K05, KB_##K06, KB_##K07 }, \
-    { KB_##K08, KB_##K09, KB_##K0A, KB_##K0B, KB_##K0C, KB_##K0D, KB_##K0E, KB_NO    }, \
-    { KB_##K10, KB_##K11, KB_##K12, KB_##K13, KB_##K14, KB_##K15, KB_##K16, KB_NO    }, \
-    { KB_##K18, KB_NO,    KB_##K1A, KB_##K1B, KB_##K1C, KB_##K1D, KB_##K1E, KB_NO    }, \
-    { KB_##K20, KB_##K21, KB_##K22, KB_##K23, KB_##K24, KB_##K25, KB_##K26, KB_NO    }, \
-    { KB_##K28, KB_##K29, KB_##K2A, KB_##K2B, KB_##K2C, KB_##K2D, KB_##K2E, KB_NO    }, \
-    { KB_##K30, KB_##K31, KB_##K32, KB_##K33, KB_##K34, KB_##K35, KB_##K36, KB_NO    }, \
-    { KB_##K38, KB_NO,    KB_##K3A, KB_##K3B, KB_##K3C, KB_##K3D, KB_##K3E, KB_NO    }, \
-    { KB_##K40, KB_##K41, KB_##K42, KB_##K43, KB_##K44, KB_##K45, KB_##K46, KB_NO    }, \
-    { KB_##K48, KB_##K49, KB_##K4A, KB_##K4B, KB_##K4C, KB_##K4D, KB_##K4E, KB_NO    }, \
-    { KB_##K50, KB_##K51, KB_##K52, KB_NO,    KB_##K54, KB_##K55, KB_NO,    KB_##K57 }, \
-    { KB_##K58, KB_##K59, KB_##K5A, KB_##K5B, KB_NO,    KB_##K5D, KB_NO,    KB_##K5F }, \
-    { KB_NO,    KB_##K61, KB_NO,    KB_NO,    KB_##K64, KB_NO,    KB_##K66, KB_##K67 }, \
-    { KB_NO,    KB_##K69, KB_##K6A, KB_##K6B, KB_##K6C, KB_NO,    KB_NO,    KB_NO    }, \
-    { KB_##K70, KB_##K71, KB_##K72, KB_##K73, KB_##K74, KB_##K75, KB_##K76, KB_##K77 }, \
-    { KB_##K78, KB_##K79, KB_##K7A, KB_##K7B, KB_##K7C, KB_##K7D, KB_##K7E, KB_NO    }, \
-    { KB_NO,    KB_NO,    KB_NO,    KB_##K83, KB_NO,    KB_NO,    KB_NO,    KB_NO    }, \
-    { KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO    }, \
-    { KB_##K90, KB_##K91, KB_NO,    KB_NO,    KB_##K94, KB_##K95, KB_NO,    KB_NO    }, \
-    { KB_##K98, KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_##K9F }, \
-    { KB_##KA0, KB_##KA1, KB_NO,    KB_##KA3, KB_NO,    KB_NO,    KB_NO,    KB_##KA7 }, \
-    { KB_##KA8, KB_NO,    KB_NO,    KB_##KAB, KB_NO,    KB_NO,    KB_NO,    KB_##KAF }, \
-    { KB_##KB0, KB_NO,    KB_##KB2, KB_NO,    KB_##KB4, KB_NO,    KB_NO,    KB_##KB7 }, \
-    { KB_##KB8, KB_NO,    KB_##KBA, KB_##KBB, KB_NO,    KB_NO,    KB_NO,    KB_##KBF }, \
-    { KB_##KC0, KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO    }, \
-    { KB_##KC8, KB_NO,    KB_##KCA, KB_NO,    KB_NO,    KB_##KCD, KB_NO,    KB_NO    }, \
-    { KB_##KD0, KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO    }, \
-    { KB_NO,    KB_NO,    KB_##KDA, KB_NO,    KB_NO,    KB_NO,    KB_##KDE, KB_NO    }, \
-    { KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO,    KB_NO    }, \
-    { KB_NO,    KB_##KE9, KB_NO,    KB_##KEB, KB_##KEC, KB_NO,    KB_NO,    KB_NO    }, \
-    { KB_##KF0, KB_##KF1, KB_##KF2, KB_NO,    KB_##KF4, KB_##KF5, KB_NO,    KB_NO    }, \
-    { KB_NO,    KB_NO,    KB_##KFA, KB_NO,    KB_##KFC, KB_##KFD, KB_##KFE, KB_NO    }, \
+    { KB_##K01, KB_##K03, KB_##K04, KB_##K05, KB_##K06, KB_##K07, KB_##K08, KB_##K09 }, \
+    { KB_##K0A, KB_##K0B, KB_##K0C, KB_##K0D, KB_##K0E, KB_##K10, KB_##K11, KB_##K12 }, \
+    { KB_##K13, KB_##K14, KB_##K15, KB_##K16, KB_##K18, KB_##K1A, KB_##K1B, KB_##K1C }, \
+    { KB_##K1D, KB_##K1E, KB_##K20, KB_##K21, KB_##K22, KB_##K23, KB_##K24, KB_##K25 }, \
+    { KB_##K26, KB_##K28, KB_##K29, KB_##K2A, KB_##K2B, KB_##K2C, KB_##K2D, KB_##K2E }, \
+    { KB_##K30, KB_##K31, KB_##K32, KB_##K33, KB_##K34, KB_##K35, KB_##K36, KB_##K38 }, \
+    { KB_##K3A, KB_##K3B, KB_##K3C, KB_##K3D, KB_##K3E, KB_##K40, KB_##K41, KB_##K42 }, \
+    { KB_##K43, KB_##K44, KB_##K45, KB_##K46, KB_##K48, KB_##K49, KB_##K4A, KB_##K4B }, \
+    { KB_##K4C, KB_##K4D, KB_##K4E, KB_##K50, KB_##K51, KB_##K52, KB_##K54, KB_##K55 }, \
+    { KB_##K57, KB_##K58, KB_##K59, KB_##K5A, KB_##K5B, KB_##K5D, KB_##K5F, KB_##K61 }, \
+    { KB_##K64, KB_##K66, KB_##K67, KB_##K69, KB_##K6A, KB_##K6B, KB_##K6C, KB_##K70 }, \
+    { KB_##K71, KB_##K72, KB_##K73, KB_##K74, KB_##K75, KB_##K76, KB_##K77, KB_##K78 }, \
+    { KB_##K79, KB_##K7A, KB_##K7B, KB_##K7C, KB_##K7D, KB_##K7E, KB_##K83, KB_##K90 }, \
+    { KB_##K91, KB_##K94, KB_##K95, KB_##K98, KB_##K9F, KB_##KA0, KB_##KA1, KB_##KA3 }, \
+    { KB_##KA7, KB_##KA8, KB_##KAB, KB_##KAF, KB_##KB0, KB_##KB2, KB_##KB4, KB_##KB7 }, \
+    { KB_##KB8, KB_##KBA, KB_##KBB, KB_##KBF, KB_##KC0, KB_##KC8, KB_##KCA, KB_##KCD }, \
+    { KB_##KD0, KB_##KDA, KB_##KDE, KB_##KE9, KB_##KEB, KB_##KEC, KB_##KF0, KB_##KF1 }, \
+    { KB_##KF2, KB_##KF4, KB_##KF5, KB_##KFA, KB_##KFC, KB_##KFD, KB_##KFE, KB_NO    }, \
 }
 
 /* US layout */
@@ -196,7 +184,8 @@ static const uint8_t PROGMEM fn_keycode[] = {
 };
 
 
-// The keymap is a 32*8 byte array which convert a PS/2 scan code into a USB keycode.
+// The keymap is a 18*8 byte array which convert a key number into a USB keycode.
+// Keys are numbered in order of PS/2 scan code(see matrix.c).
 // See usb_keycodes.h for USB keycodes. You should omit a 'KB_' prefix of USB keycodes in keymap macro.
 // Use KEYMAP_ISO() or KEYMAP_JIS() instead of KEYMAP() if your keyboard is ISO or JIS.
 static const uint8_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
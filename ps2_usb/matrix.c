@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <stdbool.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 #include "print.h"
 #include "util.h"
@@ -26,47 +27,69 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "matrix.h"
 
 
-static void matrix_make(uint8_t code);
-static void matrix_break(uint8_t code);
-#ifdef MATRIX_HAS_GHOST
-static bool matrix_has_ghost_in_row(uint8_t row);
+static void matrix_make(uint8_t key);
+static void matrix_break(uint8_t key);
+#ifdef PS2_USE_SET3
+static bool set3_init(void);
+static uint8_t set3_scan(void);
 #endif
 
 
 /*
  * Matrix Array usage:
- * 'Scan Code Set 2' is assigned into 256(32x8)cell matrix.
- * Hmm, it is very sparse and not efficient :(
+ * Keys used in keymap are numbered densely in order of their 'Scan Code Set 2'
+ * and the number is used as matrix position(row: bit 7-3, col: bit 2-0).
+ * 143 keys fit in 18x8 matrix instead of sparse 32x8.
  *
  * Notes:
  * Both 'Hanguel/English'(F1) and 'Hanja'(F2) collide with 'Delete'(E0 71) and 'Down'(E0 72).
  * These two Korean keys need exceptional handling and are not supported for now. Sorry.
  *
- *    8bit wide
- *   +---------+
- *  0|         |
- *  :|   XX    | 00-7F for normal codes(without E0-prefix)
- *  f|_________|
- * 10|         |
- *  :|  E0 YY  | 80-FF for E0-prefixed codes
- * 1f|         |     (<YY>|0x80) is used as matrix position.
- *   +---------+
+ * Scan codes are converted into key number with key_index[] below.
+ * It is indexed with XX for normal codes and (YY|0x80) for E0-prefixed codes(E0 YY),
+ * and keymap.c(KEYMAP_ALL) has to list keys in the same order.
  *
  * Exceptions:
  * 0x83:    F7(0x83) This is a normal code but beyond  0x7F.
- * 0xFC:    PrintScreen
+ * 0x84:    Alt'd PrintScreen, same key as 0xFC.
+ * 0xFC:    PrintScreen(E0 7C)
  * 0xFE:    Pause
  */
 static uint8_t matrix[MATRIX_ROWS];
-#define ROW(code)      (code>>3)
-#define COL(code)      (code&0x07)
-
-// matrix positions for exceptional keys
+#define ROW(key)       (key>>3)
+#define COL(key)       (key&0x07)
+
+#define KEY_NONE       0xFF
+#define XX             KEY_NONE
+static const uint8_t PROGMEM key_index[256] = {
+      XX, 0x00,   XX, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C,   XX, // 00
+    0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13,   XX, 0x14,   XX, 0x15, 0x16, 0x17, 0x18, 0x19,   XX, // 10
+    0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20,   XX, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,   XX, // 20
+    0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E,   XX, 0x2F,   XX, 0x30, 0x31, 0x32, 0x33, 0x34,   XX, // 30
+    0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B,   XX, 0x3C, 0x3D, 0x3E, 0x3F, 0x40, 0x41, 0x42,   XX, // 40
+    0x43, 0x44, 0x45,   XX, 0x46, 0x47,   XX, 0x48, 0x49, 0x4A, 0x4B, 0x4C,   XX, 0x4D,   XX, 0x4E, // 50
+      XX, 0x4F,   XX,   XX, 0x50,   XX, 0x51, 0x52,   XX, 0x53, 0x54, 0x55, 0x56,   XX,   XX,   XX, // 60
+    0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F, 0x60, 0x61, 0x62, 0x63, 0x64, 0x65,   XX, // 70
+      XX,   XX,   XX, 0x66, 0x8C,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX, // 80
+    0x67, 0x68,   XX,   XX, 0x69, 0x6A,   XX,   XX, 0x6B,   XX,   XX,   XX,   XX,   XX,   XX, 0x6C, // 90
+    0x6D, 0x6E,   XX, 0x6F,   XX,   XX,   XX, 0x70, 0x71,   XX,   XX, 0x72,   XX,   XX,   XX, 0x73, // A0
+    0x74,   XX, 0x75,   XX, 0x76,   XX,   XX, 0x77, 0x78,   XX, 0x79, 0x7A,   XX,   XX,   XX, 0x7B, // B0
+    0x7C,   XX,   XX,   XX,   XX,   XX,   XX,   XX, 0x7D,   XX, 0x7E,   XX,   XX, 0x7F,   XX,   XX, // C0
+    0x80,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX, 0x81,   XX,   XX,   XX, 0x82,   XX, // D0
+      XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX, 0x83,   XX, 0x84, 0x85,   XX,   XX,   XX, // E0
+    0x86, 0x87, 0x88,   XX, 0x89, 0x8A,   XX,   XX,   XX,   XX, 0x8B,   XX, 0x8C, 0x8D, 0x8E,   XX, // F0
+};
+#undef XX
+
+// scan codes for exceptional keys
 #define F7             (0x83)
 #define PRINT_SCREEN   (0xFC)
 #define PAUSE          (0xFE)
 
 static bool is_modified = false;
+#ifdef PS2_USE_SET3
+static uint8_t scan_set = 2;
+#endif
 
 
 inline
@@ -84,6 +107,10 @@ uint8_t matrix_cols(void)
 void matrix_init(void)
 {
     ps2_host_init();
+#ifdef PS2_USE_SET3
+    scan_set = set3_init() ? 3 : 2;
+    debug("scan code set: "); debug_hex(scan_set); debug("\n");
+#endif
 
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) matrix[i] = 0x00;
@@ -154,214 +181,265 @@ void matrix_init(void)
  *               because it has no break code.
  *
  */
-uint8_t matrix_scan(void)
-{
 
-    // scan code reading states
-    static enum {
-        INIT,
-        F0,
-        E0,
-        E0_F0,
-        // Pause
-        E1,
-        E1_14,
-        E1_14_77,
-        E1_14_77_E1,
-        E1_14_77_E1_F0,
-        E1_14_77_E1_F0_14,
-        E1_14_77_E1_F0_14_F0,
-        // Control'd Pause
-        E0_7E,
-        E0_7E_E0,
-        E0_7E_E0_F0,
-    } state = INIT;
+/*
+ * Decoder tables
+ * A byte is classified with byte_class[] first, then trans[state][class]
+ * gives action to take and next state. Only bytes which matter to prefix
+ * and Pause sequences have their own class.
+ */
+enum {
+    C_KEY,      // 01-7F: key code
+    C_HI,       // 83, 84: key code beyond 7F(F7, Alt'd PrintScreen)
+    C_E0,
+    C_E1,
+    C_F0,
+    C_SHIFT,    // 12, 59: Shift, or fake Shift after E0
+    C_14,       // Control, in Pause sequence
+    C_77,       // NumLock, in Pause sequence
+    C_7E,       // ScrollLock, in Control'd Pause sequence
+    C_BAD,      // others: unexpected
+    CLASSES
+};
+
+static const uint8_t PROGMEM byte_class[256] = {
+#define K   C_KEY
+#define H   C_HI
+#define S   C_SHIFT
+#define C   C_14
+#define N   C_77
+#define L   C_7E
+#define B   C_BAD
+    B, K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, // 00
+    K, K, S, K, C, K, K, K, K, K, K, K, K, K, K, K, // 10
+    K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, // 20
+    K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, // 30
+    K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, // 40
+    K, K, K, K, K, K, K, K, K, S, K, K, K, K, K, K, // 50
+    K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, K, // 60
+    K, K, K, K, K, K, K, N, K, K, K, K, K, K, L, K, // 70
+    B, B, B, H, H, B, B, B, B, B, B, B, B, B, B, B, // 80
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // 90
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // A0
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // B0
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // C0
+    B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // D0
+    C_E0, C_E1, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // E0
+    C_F0, B, B, B, B, B, B, B, B, B, B, B, B, B, B, B, // F0
+#undef K
+#undef H
+#undef S
+#undef C
+#undef N
+#undef L
+#undef B
+};
+
+enum {
+    INIT,
+    F0,
+    E0,
+    E0_F0,
+    // Pause
+    E1,
+    E1_14,
+    E1_14_77,
+    E1_14_77_E1,
+    E1_14_77_E1_F0,
+    E1_14_77_E1_F0_14,
+    E1_14_77_E1_F0_14_F0,
+    // Control'd Pause
+    E0_7E,
+    E0_7E_E0,
+    E0_7E_E0_F0,
+    STATES
+};
+
+enum {
+    A_NONE,
+    A_MAKE,     // make key of normal code
+    A_BREAK,    // break key of normal code
+    A_MAKE_E0,  // make key of E0-prefixed code
+    A_BREAK_E0, // break key of E0-prefixed code
+    A_PAUSE,    // make Pause
+    A_ERROR,    // unexpected code
+};
+
+// action: bit 7-4, next state: bit 3-0
+#define T(action, next)    ((action)<<4 | (next))
+#define ACTION(t)          ((t)>>4)
+#define NEXT(t)            ((t)&0x0F)
+
+static const uint8_t PROGMEM trans[STATES][CLASSES] = {
+#define GO(s)   T(A_NONE, s)
+#define ___     T(A_NONE, INIT)
+#define MAKE    T(A_MAKE, INIT)
+#define BRK     T(A_BREAK, INIT)
+#define MAKE_E0 T(A_MAKE_E0, INIT)
+#define BRK_E0  T(A_BREAK_E0, INIT)
+#define PAUS    T(A_PAUSE, INIT)
+#define ERR     T(A_ERROR, INIT)
+    /*                          KEY      HI       E0                E1             F0                          SHIFT    14                      77                 7E          BAD */
+    [INIT]                 = { MAKE,    MAKE,    GO(E0),           GO(E1),        GO(F0),                     MAKE,    MAKE,                   MAKE,              MAKE,       ERR },
+    [F0]                   = { BRK,     BRK,     ERR,              ERR,           ERR,                        BRK,     BRK,                    BRK,               BRK,        ERR },
+    [E0]                   = { MAKE_E0, ERR,     ERR,              ERR,           GO(E0_F0),                  ___,     MAKE_E0,                MAKE_E0,           GO(E0_7E),  ERR },
+    [E0_F0]                = { BRK_E0,  ERR,     ERR,              ERR,           ERR,                        ___,     BRK_E0,                 BRK_E0,            BRK_E0,     ERR },
+    [E1]                   = { ___,     ___,     ___,              ___,           ___,                        ___,     GO(E1_14),              ___,               ___,        ___ },
+    [E1_14]                = { ___,     ___,     ___,              ___,           ___,                        ___,     ___,                    GO(E1_14_77),      ___,        ___ },
+    [E1_14_77]             = { ___,     ___,     ___,              GO(E1_14_77_E1), ___,                      ___,     ___,                    ___,               ___,        ___ },
+    [E1_14_77_E1]          = { ___,     ___,     ___,              ___,           GO(E1_14_77_E1_F0),         ___,     ___,                    ___,               ___,        ___ },
+    [E1_14_77_E1_F0]       = { ___,     ___,     ___,              ___,           ___,                        ___,     GO(E1_14_77_E1_F0_14),  ___,               ___,        ___ },
+    [E1_14_77_E1_F0_14]    = { ___,     ___,     ___,              ___,           GO(E1_14_77_E1_F0_14_F0),   ___,     ___,                    ___,               ___,        ___ },
+    [E1_14_77_E1_F0_14_F0] = { ___,     ___,     ___,              ___,           ___,                        ___,     ___,                    PAUS,              ___,        ___ },
+    [E0_7E]                = { ___,     ___,     GO(E0_7E_E0),     ___,           ___,                        ___,     ___,                    ___,               ___,        ___ },
+    [E0_7E_E0]             = { ___,     ___,     ___,              ___,           GO(E0_7E_E0_F0),            ___,     ___,                    ___,               ___,        ___ },
+    [E0_7E_E0_F0]          = { ___,     ___,     ___,              ___,           ___,                        ___,     ___,                    ___,               PAUS,       ___ },
+#undef GO
+#undef ___
+#undef MAKE
+#undef BRK
+#undef MAKE_E0
+#undef BRK_E0
+#undef PAUS
+#undef ERR
+};
+
+static inline uint8_t code_to_key(uint8_t code)
+{
+    return pgm_read_byte(&key_index[code]);
+}
 
+uint8_t matrix_scan(void)
+{
+    static uint8_t state = INIT;
 
     is_modified = false;
 
-    // 'pseudo break code' hack
-    if (matrix_is_on(ROW(PAUSE), COL(PAUSE))) {
-        matrix_break(PAUSE);
+#ifdef PS2_USE_SET3
+    if (scan_set == 3) {
+        return set3_scan();
     }
+#endif
+
+    // 'pseudo break code' hack
+    matrix_break(code_to_key(PAUSE));
 
     uint8_t code;
     while ((code = ps2_host_recv())) {
-        switch (state) {
-            case INIT:
-                switch (code) {
-                    case 0xE0:
-                        state = E0;
-                        break;
-                    case 0xF0:
-                        state = F0;
-                        break;
-                    case 0xE1:
-                        state = E1;
-                        break;
-                    case 0x83:  // F7
-                        matrix_make(F7);
-                        state = INIT;
-                        break;
-                    case 0x84:  // Alt'd PrintScreen
-                        matrix_make(PRINT_SCREEN);
-                        state = INIT;
-                        break;
-                    default:    // normal key make
-                        if (code < 0x80) {
-                            matrix_make(code);
-                        } else {
-                            debug("unexpected scan code at INIT: "); debug_hex(code); debug("\n");
-                        }
-                        state = INIT;
-                }
-                break;
-            case E0:    // E0-Prefixed
-                switch (code) {
-                    case 0x12:  // to be ignored
-                    case 0x59:  // to be ignored
-                        state = INIT;
-                        break;
-                    case 0x7E:  // Control'd Pause
-                        state = E0_7E;
-                        break;
-                    case 0xF0:
-                        state = E0_F0;
-                        break;
-                    default:
-                        if (code < 0x80) {
-                            matrix_make(code|0x80);
-                        } else {
-                            debug("unexpected scan code at E0: "); debug_hex(code); debug("\n");
-                        }
-                        state = INIT;
-                }
-                break;
-            case F0:    // Break code
-                switch (code) {
-                    case 0x83:  // F7
-                        matrix_break(F7);
-                        state = INIT;
-                        break;
-                    case 0x84:  // Alt'd PrintScreen
-                        matrix_break(PRINT_SCREEN);
-                        state = INIT;
-                        break;
-                    default:
-                    if (code < 0x80) {
-                        matrix_break(code);
-                    } else {
-                        debug("unexpected scan code at F0: "); debug_hex(code); debug("\n");
-                    }
-                    state = INIT;
-                }
-                break;
-            case E0_F0: // Break code of E0-prefixed
-                switch (code) {
-                    case 0x12:  // to be ignored
-                    case 0x59:  // to be ignored
-                        state = INIT;
-                        break;
-                    default:
-                        if (code < 0x80) {
-                            matrix_break(code|0x80);
-                        } else {
-                            debug("unexpected scan code at E0_F0: "); debug_hex(code); debug("\n");
-                        }
-                        state = INIT;
-                }
-                break;
-            // following are states of Pause
-            case E1:
-                switch (code) {
-                    case 0x14:
-                        state = E1_14;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14:
-                switch (code) {
-                    case 0x77:
-                        state = E1_14_77;
-                        break;
-                    default:
-                        state = INIT;
-                }
-                break;
-            case E1_14_77:
-                switch (code) {
-                    case 0xE1:
-                        state = E1_14_77_E1;
-                        break;
-                    default:
-                        state = INIT;
-                }
+        uint8_t t = pgm_read_byte(&trans[state][pgm_read_byte(&byte_class[code])]);
+        state = NEXT(t);
+        switch (ACTION(t)) {
+            case A_MAKE:
+                matrix_make(code_to_key(code));
                 break;
-            case E1_14_77_E1:
-                switch (code) {
-                    case 0xF0:
-                        state = E1_14_77_E1_F0;
-                        break;
-                    default:
-                        state = INIT;
-                }
+            case A_BREAK:
+                matrix_break(code_to_key(code));
                 break;
-            case E1_14_77_E1_F0:
-                switch (code) {
-                    case 0x14:
-                        state = E1_14_77_E1_F0_14;
-                        break;
-                    default:
-                        state = INIT;
-                }
+            case A_MAKE_E0:
+                matrix_make(code_to_key(code|0x80));
                 break;
-            case E1_14_77_E1_F0_14:
-                switch (code) {
-                    case 0xF0:
-                        state = E1_14_77_E1_F0_14_F0;
-                        break;
-                    default:
-                        state = INIT;
-                }
+            case A_BREAK_E0:
+                matrix_break(code_to_key(code|0x80));
                 break;
-            case E1_14_77_E1_F0_14_F0:
-                switch (code) {
-                    case 0x77:
-                        matrix_make(PAUSE);
-                        state = INIT;
-                        break;
-                    default:
-                        state = INIT;
-                }
+            case A_PAUSE:
+                matrix_make(code_to_key(PAUSE));
                 break;
-            // Following are states of Control'd Pause
-            case E0_7E:
-                if (code == 0xE0)
-                    state = E0_7E_E0;
-                else
-                    state = INIT;
+            case A_ERROR:
+                debug("unexpected scan code: "); debug_hex(code); debug("\n");
                 break;
-            case E0_7E_E0:
-                if (code == 0xF0)
-                    state = E0_7E_E0_F0;
-                else
-                    state = INIT;
-                break;
-            case E0_7E_E0_F0:
-                if (code == 0x7E)
-                    matrix_make(PAUSE);
-                state = INIT;
-                break;
-            default:
-                state = INIT;
         }
         phex(code);
     }
     return 1;
 }
 
+#ifdef PS2_USE_SET3
+/*
+ * PS/2 Scan Code Set 3
+ *
+ * With all keys set to make/break mode(F8) every key sends one byte code
+ * on make and F0 and the code on break, without prefixes, fake shifts or
+ * typematic repeat. Pause has its own break code too.
+ * Codes are mapped to the same key numbers as Set 2 with set3_index[] so that
+ * keymap is shared. Keys missing in Set 3(multimedia, F13-24) are not used.
+ *
+ * Keyboards which don't support Set 3 refuse F0 03 or keep Set 2 though they
+ * ACK it, then we go back to Set 2.
+ */
+#define XX             KEY_NONE
+static const uint8_t PROGMEM set3_index[0x90] = {
+      XX,   XX,   XX,   XX,   XX,   XX,   XX, 0x03, 0x5D,   XX,   XX,   XX,   XX, 0x0B, 0x0C, 0x04, // 00
+      XX, 0x11, 0x0F, 0x4F, 0x49, 0x12, 0x13, 0x02,   XX, 0x0E, 0x15, 0x16, 0x17, 0x18, 0x19, 0x0A, // 10
+      XX, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x01,   XX, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x09, // 20
+      XX, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x66,   XX, 0x68, 0x30, 0x31, 0x32, 0x33, 0x34, 0x08, // 30
+      XX, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x00,   XX, 0x3D, 0x3E, 0x3F, 0x40, 0x41, 0x42, 0x07, // 40
+      XX, 0x44, 0x45, 0x4D, 0x46, 0x47, 0x5F, 0x8C, 0x69, 0x4A, 0x4B, 0x4C, 0x4D, 0x54, 0x05, 0x65, // 50
+    0x88, 0x84, 0x8E, 0x8A, 0x87, 0x83, 0x51, 0x86,   XX, 0x53, 0x89, 0x55, 0x56, 0x8B, 0x85, 0x8D, // 60
+    0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5E, 0x7E,   XX, 0x81, 0x61,   XX, 0x60, 0x64, 0x63,   XX, // 70
+      XX,   XX,   XX,   XX, 0x62, 0x52, 0x50, 0x10,   XX,   XX,   XX, 0x6C, 0x70, 0x73,   XX,   XX, // 80
+};
+#undef XX
+
+/* wait response to command byte, returns 0 when timeout */
+static uint8_t recv_byte(uint8_t ms)
+{
+    uint8_t data;
+    while (!(data = ps2_host_recv()) && ms--) {
+        _delay_ms(1);
+    }
+    return data;
+}
+
+static bool set3_init(void)
+{
+    // select Set 3
+    if (ps2_host_send(0xF0) != PS2_ACK) goto FALLBACK;
+    if (ps2_host_send(0x03) != PS2_ACK) goto FALLBACK;
+
+    // read current set to confirm
+    if (ps2_host_send(0xF0) != PS2_ACK) goto FALLBACK;
+    if (ps2_host_send(0x00) != PS2_ACK) goto FALLBACK;
+    if (recv_byte(25) != 0x03) goto FALLBACK;
+
+    // make/break for all keys
+    if (ps2_host_send(0xF8) != PS2_ACK) goto FALLBACK;
+    return true;
+
+FALLBACK:
+    debug("Set 3: not supported\n");
+    ps2_host_send(0xF0);
+    ps2_host_send(0x02);
+    return false;
+}
+
+static uint8_t set3_scan(void)
+{
+    static bool brk = false;
+
+    uint8_t code;
+    while ((code = ps2_host_recv())) {
+        if (code == 0xF0) {
+            brk = true;
+        } else {
+            uint8_t key = KEY_NONE;
+            if (code < sizeof(set3_index))
+                key = pgm_read_byte(&set3_index[code]);
+
+            if (key == KEY_NONE) {
+                debug("unexpected scan code: "); debug_hex(code); debug("\n");
+            } else if (brk) {
+                matrix_break(key);
+            } else {
+                matrix_make(key);
+            }
+            brk = false;
+        }
+        phex(code);
+    }
+    return 1;
+}
+#endif
+
 bool matrix_is_modified(void)
 {
     return is_modified;
@@ -371,12 +449,10 @@ inline
 bool matrix_has_ghost(void)
 {
 #ifdef MATRIX_HAS_GHOST
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-        if (matrix_has_ghost_in_row(i))
-            return true;
-    }
-#endif
+    return matrix_ghost_update();
+#else
     return false;
+#endif
 }
 
 inline
@@ -398,7 +474,7 @@ void matrix_print(void)
         phex(row); print(": ");
         pbin_reverse(matrix_get_row(row));
 #ifdef MATRIX_HAS_GHOST
-        if (matrix_has_ghost_in_row(row)) {
+        if (matrix_ghost_row(row)) {
             print(" <ghost");
         }
 #endif
@@ -415,38 +491,24 @@ uint8_t matrix_key_count(void)
     return count;
 }
 
-#ifdef MATRIX_HAS_GHOST
-inline
-static bool matrix_has_ghost_in_row(uint8_t row)
-{
-    // no ghost exists in case less than 2 keys on
-    if (((matrix[row] - 1) & matrix[row]) == 0)
-        return false;
-
-    // ghost exists in case same state as other row
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) {
-        if (i != row && (matrix[i] & matrix[row]) == matrix[row])
-            return true;
-    }
-    return false;
-}
-#endif
 
 
 inline
-static void matrix_make(uint8_t code)
+static void matrix_make(uint8_t key)
 {
-    if (!matrix_is_on(ROW(code), COL(code))) {
-        matrix[ROW(code)] |= 1<<COL(code);
+    if (key == KEY_NONE) return;
+    if (!matrix_is_on(ROW(key), COL(key))) {
+        matrix[ROW(key)] |= 1<<COL(key);
         is_modified = true;
     }
 }
 
 inline
-static void matrix_break(uint8_t code)
+static void matrix_break(uint8_t key)
 {
-    if (matrix_is_on(ROW(code), COL(code))) {
-        matrix[ROW(code)] &= ~(1<<COL(code));
+    if (key == KEY_NONE) return;
+    if (matrix_is_on(ROW(key), COL(key))) {
+        matrix[ROW(key)] &= ~(1<<COL(key));
         is_modified = true;
     }
 }
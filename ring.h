@@ -0,0 +1,102 @@
+/*
+Copyright 2012 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+
+/*
+ * Byte ring buffer for single producer and single consumer
+ *
+ * RING_DEFINE(name, size, stat) defines static buffer name_buf[size] with
+ * indexes name_head/name_tail and following functions:
+ *     bool    name_put(uint8_t data)   store data, false when full
+ *     uint8_t name_get(void)           take data, 0 when empty
+ *     bool    name_empty(void)
+ *     bool    name_full(void)
+ *     uint8_t name_count(void)         number of bytes stored
+ *     void    name_clear(void)         discard all data
+ *
+ * size must be power of 2 and 256 or less, a ring holds (size - 1) bytes.
+ * stat is a ring_stat_t variable where producer records statistics.
+ *
+ * Producer(ISR) only writes head and consumer(main loop) only writes tail,
+ * both are one byte and updated after data, so that no interrupt disable is
+ * needed on either side. Either side can also be main loop and the other ISR.
+ */
+typedef struct {
+    uint8_t  high;      // high-water mark: most bytes stored at once
+    uint16_t overflow;  // bytes dropped while full
+} ring_stat_t;
+
+#define RING_DEFINE(name, size, stat) \
+typedef char name##_size_must_be_power_of_2_and_256_or_less \
+    [(((size) & ((size) - 1)) == 0 && (size) <= 256) ? 1 : -1]; \
+static volatile uint8_t name##_buf[size]; \
+static volatile uint8_t name##_head = 0; \
+static volatile uint8_t name##_tail = 0; \
+\
+static inline bool name##_put(uint8_t data) \
+{ \
+    uint8_t head = name##_head; \
+    uint8_t next = (head + 1) & ((size) - 1); \
+    if (next == name##_tail) { \
+        (stat).overflow++; \
+        return false; \
+    } \
+    name##_buf[head] = data; \
+    name##_head = next; \
+    uint8_t count = (next - name##_tail) & ((size) - 1); \
+    if (count > (stat).high) \
+        (stat).high = count; \
+    return true; \
+} \
+static inline uint8_t name##_get(void) \
+{ \
+    uint8_t tail = name##_tail; \
+    if (tail == name##_head) \
+        return 0; \
+    uint8_t data = name##_buf[tail]; \
+    name##_tail = (tail + 1) & ((size) - 1); \
+    return data; \
+} \
+static inline bool name##_empty(void) \
+{ \
+    return name##_head == name##_tail; \
+} \
+static inline bool name##_full(void) \
+{ \
+    return ((name##_head + 1) & ((size) - 1)) == name##_tail; \
+} \
+static inline uint8_t name##_count(void) \
+{ \
+    return (name##_head - name##_tail) & ((size) - 1); \
+} \
+static inline void name##_clear(void) \
+{ \
+    uint8_t sreg = SREG; \
+    cli(); \
+    name##_head = name##_tail = 0; \
+    SREG = sreg; \
+}
+
+#endif
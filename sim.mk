@@ -0,0 +1,74 @@
+# Host simulation build of keyboard core
+#   make sim    builds $(TARGET)_sim with host compiler. see README
+#   make sim_test   runs host tests in sim/test/
+#
+# Board keymap and config are used as they are, matrix and host driver
+# are replaced with scripted ones and AVR headers with shims in sim/.
+SIM_CC = gcc
+SIM_DIR = $(COMMON_DIR)/sim
+SIM_OBJDIR = obj_$(TARGET)_sim
+
+# PS/2 converter runs its own matrix.c on scripted keyboard, with
+# SIM_PS2_INT=yes interrupt driven ps2.c runs on keyboard simulated in line level
+SIM_MATRIX = sim_matrix.c
+ifneq ($(filter ps2.c ps2_usart.c, $(SRC)),)
+ifndef PS2_MOUSE_ENABLE
+ifdef SIM_PS2_INT
+    SIM_MATRIX = matrix.c led.c ps2.c sim_ps2_int.c
+else
+    SIM_MATRIX = matrix.c sim_ps2.c
+endif
+endif
+endif
+
+SIM_SRC = sim.c \
+	sim_hal.c \
+	$(SIM_MATRIX) \
+	$(filter keymap%.c, $(SRC)) \
+	$(filter host.c keyboard.c command.c layer.c ghost.c print.c bootloader.c util.c mousekey.c latency.c, $(SRC))
+
+SIM_OBJ = $(patsubst %.c,$(SIM_OBJDIR)/%.o,$(SIM_SRC))
+
+SIM_CFLAGS = -std=gnu99 -O2 -Wall -Wstrict-prototypes
+SIM_CFLAGS += -funsigned-char -fcommon
+SIM_CFLAGS += -DF_CPU=$(F_CPU)UL
+SIM_CFLAGS += $(filter-out -DHOST_% -DPS2_MOUSE_ENABLE, $(OPT_DEFS))
+SIM_CFLAGS += -I$(SIM_DIR) -I$(COMMON_DIR) -I$(TARGET_DIR)
+SIM_CFLAGS += -include avr/io.h -include $(CONFIG_H)
+ifdef SIM_PS2_INT
+SIM_CFLAGS += -include sim_ps2_int.h
+endif
+
+vpath %.c $(SIM_DIR)
+
+
+sim: $(TARGET)_sim
+
+$(TARGET)_sim: $(SIM_OBJ)
+	$(SIM_CC) -o $@ $^
+
+$(SIM_OBJDIR)/%.o : %.c
+	@mkdir -p $(SIM_OBJDIR)
+	$(SIM_CC) -c $(SIM_CFLAGS) $< -o $@
+
+
+# debounce.c is tested with each algorithm and counter width
+SIM_TEST_DEBOUNCE = 0 3 7
+SIM_TEST_DEBOUNCE_TYPE = DEBOUNCE_SYM DEBOUNCE_EAGER DEBOUNCE_DEFER
+SIM_TEST_CFLAGS = -std=gnu99 -O2 -Wall -Wstrict-prototypes -funsigned-char -fcommon
+SIM_TEST_CFLAGS += -DF_CPU=$(F_CPU)UL -DMATRIX_ROWS=4 -DMATRIX_COLS=8
+SIM_TEST_CFLAGS += -I$(SIM_DIR) -I$(COMMON_DIR) -I$(TARGET_DIR) -include avr/io.h
+
+sim_test:
+	@mkdir -p $(SIM_OBJDIR)
+	@for t in $(SIM_TEST_DEBOUNCE_TYPE); do for d in $(SIM_TEST_DEBOUNCE); do \
+		$(SIM_CC) $(SIM_TEST_CFLAGS) -DDEBOUNCE=$$d -DDEBOUNCE_TYPE=$$t \
+			-o $(SIM_OBJDIR)/debounce_test $(SIM_DIR)/test/debounce_test.c \
+			$(COMMON_DIR)/debounce.c $(COMMON_DIR)/print.c $(SIM_DIR)/sim_hal.c && \
+		$(SIM_OBJDIR)/debounce_test || exit 1; \
+	done; done
+
+sim_clean:
+	rm -rf $(SIM_OBJDIR) $(TARGET)_sim
+
+.PHONY: sim sim_test sim_clean
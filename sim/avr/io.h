@@ -0,0 +1,37 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * AVR register shim for host simulation build.
+ * Registers are plain variables defined in sim_hal.c.
+ */
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t TCNT0;
+extern volatile uint8_t TIFR0;
+#define OCF0A 1
+extern volatile uint8_t PINB, PORTB, DDRB;
+extern volatile uint8_t PINC, PORTC, DDRC;
+extern volatile uint8_t PIND, PORTD, DDRD;
+extern volatile uint8_t PINE, PORTE, DDRE;
+extern volatile uint8_t PINF, PORTF, DDRF;
+
+#endif
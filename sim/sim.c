@@ -0,0 +1,255 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host simulation runner
+ * Runs keyboard core with scripted matrix and prints what is sent to host.
+ *
+ * Script(files in arguments or stdin), one command in a line:
+ *     d <row> <col>   press switch
+ *     u <row> <col>   release switch
+ *     k <hex> ...     bytes sent from PS/2 keyboard
+ *     e <hex>         byte with parity error from PS/2 keyboard(SIM_PS2_INT)
+ *     w <ms>          keep scanning for ms
+ *     l <leds>        set LED state of host in hex
+ *     # ...           comment
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "keyboard.h"
+#include "host.h"
+#include "print.h"
+#include "debug.h"
+#include "sim.h"
+
+
+bool debug_enable = false;
+bool debug_matrix = false;
+bool debug_keyboard = false;
+bool debug_mouse = false;
+
+// time a scan takes on simulated clock
+static uint32_t scan_us = 1000;
+static bool quiet = false;
+static uint8_t leds = 0;
+static uint32_t scans = 0;
+static uint32_t reports = 0;
+
+static uint8_t keyboard_leds(void);
+static void send_keyboard(report_keyboard_t *report);
+static void send_mouse(report_mouse_t *report);
+static void send_system(uint16_t data);
+static void send_consumer(uint16_t data);
+
+static host_driver_t driver = {
+    keyboard_leds,
+    send_keyboard,
+    send_mouse,
+    send_system,
+    send_consumer
+};
+
+#define TIMESTAMP() printf("%7u.%03u ", sim_time_us() / 1000, sim_time_us() % 1000)
+
+
+static uint8_t keyboard_leds(void)
+{
+    return leds;
+}
+
+static void send_keyboard(report_keyboard_t *report)
+{
+    reports++;
+    if (quiet) return;
+    TIMESTAMP();
+    printf("keyboard %02X |", report->mods);
+    for (uint8_t i = 0; i < REPORT_KEYS; i++) {
+        printf(" %02X", report->keys[i]);
+    }
+    printf("\n");
+}
+
+static void send_mouse(report_mouse_t *report)
+{
+    reports++;
+    if (quiet) return;
+    TIMESTAMP();
+    printf("mouse %02X | %d %d %d %d\n", report->buttons,
+            report->x, report->y, report->v, report->h);
+}
+
+static void send_system(uint16_t data)
+{
+    reports++;
+    if (quiet) return;
+    TIMESTAMP();
+    printf("system %04X\n", data);
+}
+
+static void send_consumer(uint16_t data)
+{
+    reports++;
+    if (quiet) return;
+    TIMESTAMP();
+    printf("consumer %04X\n", data);
+}
+
+
+static void run(uint32_t ms)
+{
+    uint32_t end = sim_time_us() + ms * 1000;
+    while (sim_time_us() < end) {
+        keyboard_proc();
+        sim_ps2_task();
+        scans++;
+        sim_delay_us(scan_us);
+    }
+}
+
+/* matrix or PS/2 keyboard: target links only one of them */
+void sim_matrix_set(uint8_t row, uint8_t col, bool on) __attribute__ ((weak));
+void sim_matrix_set(uint8_t row, uint8_t col, bool on)
+{
+    fprintf(stderr, "switch is not supported by this target\n");
+    exit(1);
+}
+
+void sim_ps2_put(uint8_t data) __attribute__ ((weak));
+void sim_ps2_put(uint8_t data)
+{
+    fprintf(stderr, "PS/2 keyboard is not supported by this target\n");
+    exit(1);
+}
+
+void sim_ps2_put_error(uint8_t data) __attribute__ ((weak));
+void sim_ps2_put_error(uint8_t data)
+{
+    fprintf(stderr, "PS/2 line is not simulated in this target\n");
+    exit(1);
+}
+
+void sim_ps2_task(void) __attribute__ ((weak));
+void sim_ps2_task(void)
+{
+}
+
+static bool keyboard_bytes(char *s)
+{
+    unsigned int a;
+    int n, count = 0;
+    while (sscanf(s, "%x%n", &a, &n) == 1) {
+        sim_ps2_put(a);
+        s += n;
+        count++;
+    }
+    return count;
+}
+
+static void script(FILE *fp, const char *name)
+{
+    char line[128];
+    unsigned int a, b;
+    int n = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        n++;
+        switch (line[0]) {
+            case 'd':
+            case 'u':
+                if (sscanf(line + 1, "%u %u", &a, &b) != 2) goto error;
+                sim_matrix_set(a, b, line[0] == 'd');
+                break;
+            case 'k':
+                if (!keyboard_bytes(line + 1)) goto error;
+                break;
+            case 'e':
+                if (sscanf(line + 1, "%x", &a) != 1) goto error;
+                sim_ps2_put_error(a);
+                break;
+            case 'w':
+                if (sscanf(line + 1, "%u", &a) != 1) goto error;
+                run(a);
+                break;
+            case 'l':
+                if (sscanf(line + 1, "%x", &a) != 1) goto error;
+                leds = a;
+                break;
+            case '#':
+            case '\n':
+            case '\r':
+                break;
+            default:
+                goto error;
+        }
+    }
+    return;
+error:
+    fprintf(stderr, "%s:%d: invalid command: %s", name, n, line);
+    exit(1);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-q] [-d] [-s scan_us] [script ...]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "qds:")) != -1) {
+        switch (opt) {
+            case 'q':
+                quiet = true;
+                break;
+            case 'd':
+                print_enable = true;
+                debug_enable = true;
+                debug_keyboard = true;
+                break;
+            case 's':
+                scan_us = atoi(optarg);
+                if (!scan_us) usage(argv[0]);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    keyboard_init();
+    host_set_driver(&driver);
+
+    if (optind == argc) {
+        script(stdin, "-");
+    }
+    for (int i = optind; i < argc; i++) {
+        FILE *fp = fopen(argv[i], "r");
+        if (!fp) {
+            perror(argv[i]);
+            return 1;
+        }
+        script(fp, argv[i]);
+        fclose(fp);
+    }
+
+    fprintf(stderr, "scans: %u  reports: %u  time: %ums\n",
+            scans, reports, sim_time_us() / 1000);
+    return 0;
+}
@@ -0,0 +1,38 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/* simulated clock in microseconds */
+uint32_t sim_time_us(void);
+void sim_delay_us(uint32_t us);
+
+/* switch state which matrix_scan() reads */
+void sim_matrix_set(uint8_t row, uint8_t col, bool on);
+
+/* byte which PS/2 keyboard sends(PS/2 converter targets) */
+void sim_ps2_put(uint8_t data);
+/* byte with parity error and keyboard on every scan(SIM_PS2_INT) */
+void sim_ps2_put_error(uint8_t data);
+void sim_ps2_task(void);
+
+#endif
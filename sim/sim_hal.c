@@ -0,0 +1,88 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Hardware shim for host simulation: registers, timer, console and LEDs.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include "timer.h"
+#include "sendchar.h"
+#include "led.h"
+#include "sim.h"
+
+
+volatile uint8_t SREG;
+volatile uint8_t TCNT0;
+volatile uint8_t TIFR0;
+volatile uint8_t PINB, PORTB, DDRB;
+volatile uint8_t PINC, PORTC, DDRC;
+volatile uint8_t PIND, PORTD, DDRD;
+volatile uint8_t PINE, PORTE, DDRE;
+volatile uint8_t PINF, PORTF, DDRF;
+
+volatile uint16_t timer_count = 0;
+
+static uint32_t time_us = 0;
+
+
+uint32_t sim_time_us(void)
+{
+    return time_us;
+}
+
+void sim_delay_us(uint32_t us)
+{
+    time_us += us;
+    timer_count = time_us / 1000;
+    TCNT0 = (time_us % 1000) * TIMER_RAW_TOP / 1000;
+}
+
+
+void timer_init(void)
+{
+}
+
+void timer_clear(void)
+{
+    timer_count = 0;
+}
+
+uint16_t timer_read(void)
+{
+    return timer_count;
+}
+
+uint16_t timer_elapsed(uint16_t last)
+{
+    return TIMER_DIFF_MS(timer_count, last);
+}
+
+
+int8_t sendchar(uint8_t c)
+{
+    fputc(c, stderr);
+    return 0;
+}
+
+/* board led.c replaces this when it is linked(SIM_PS2_INT) */
+void led_set(uint8_t usb_led) __attribute__ ((weak));
+void led_set(uint8_t usb_led)
+{
+    printf("%7u.%03u led %02X\n", time_us / 1000, time_us % 1000, usb_led);
+}
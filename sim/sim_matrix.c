@@ -0,0 +1,116 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Scripted matrix for host simulation
+ * Switches are set by script with sim_matrix_set() and read in matrix_scan().
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "print.h"
+#include "util.h"
+#include "matrix.h"
+#include "sim.h"
+
+
+static matrix_row_t switches[MATRIX_ROWS];
+static matrix_row_t matrix[MATRIX_ROWS];
+static bool is_modified = false;
+
+
+void sim_matrix_set(uint8_t row, uint8_t col, bool on)
+{
+    if (row >= MATRIX_ROWS || col >= MATRIX_COLS) return;
+    if (on)
+        switches[row] |= ((matrix_row_t)1<<col);
+    else
+        switches[row] &= ~((matrix_row_t)1<<col);
+}
+
+inline
+uint8_t matrix_rows(void)
+{
+    return MATRIX_ROWS;
+}
+
+inline
+uint8_t matrix_cols(void)
+{
+    return MATRIX_COLS;
+}
+
+void matrix_init(void)
+{
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) matrix[i] = 0;
+}
+
+uint8_t matrix_scan(void)
+{
+    is_modified = false;
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        if (matrix[i] != switches[i]) {
+            matrix[i] = switches[i];
+            is_modified = true;
+        }
+    }
+    return 1;
+}
+
+bool matrix_is_modified(void)
+{
+    return is_modified;
+}
+
+bool matrix_has_ghost(void)
+{
+#ifdef MATRIX_HAS_GHOST
+    return matrix_ghost_update();
+#else
+    return false;
+#endif
+}
+
+inline
+bool matrix_is_on(uint8_t row, uint8_t col)
+{
+    return (matrix[row] & ((matrix_row_t)1<<col));
+}
+
+inline
+matrix_row_t matrix_get_row(uint8_t row)
+{
+    return matrix[row];
+}
+
+void matrix_print(void)
+{
+    print("\nr/c 01234567\n");
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        phex(row); print(": ");
+        pbin_reverse(matrix[row]);
+        print("\n");
+    }
+}
+
+uint8_t matrix_key_count(void)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        count += bitpop(matrix[i]);
+    }
+    return count;
+}
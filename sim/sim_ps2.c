@@ -0,0 +1,85 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Scripted PS/2 keyboard for host simulation
+ * Bytes put with sim_ps2_put() are received by board matrix.c through
+ * ps2_host_recv(). Commands sent to keyboard are printed and acknowledged,
+ * and scan code set selected with F0 is answered to query(F0 00).
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ps2.h"
+#include "sim.h"
+
+
+#define SIM_PS2_BUF_SIZE 256
+
+uint8_t ps2_error = PS2_ERR_NONE;
+
+static uint8_t buf[SIM_PS2_BUF_SIZE];
+static uint8_t head = 0;
+static uint8_t tail = 0;
+static uint8_t scan_set = 2;
+static uint8_t last_command = 0;
+
+
+void sim_ps2_put(uint8_t data)
+{
+    buf[head++] = data;
+    if (head == tail) {
+        fprintf(stderr, "sim ps2: buffer overflow\n");
+        tail++;
+    }
+}
+
+void ps2_host_init(void)
+{
+}
+
+uint8_t ps2_host_send(uint8_t data)
+{
+    printf("%7u.%03u ps2 send %02X\n", sim_time_us() / 1000, sim_time_us() % 1000, data);
+    if (last_command == 0xF0) {
+        if (data)
+            scan_set = data;
+        else
+            sim_ps2_put(scan_set);
+        data = 0;
+    }
+    last_command = data;
+    return PS2_ACK;
+}
+
+uint8_t ps2_host_recv_response(void)
+{
+    return PS2_ACK;
+}
+
+uint8_t ps2_host_recv(void)
+{
+    if (head == tail)
+        return 0;
+    return buf[tail++];
+}
+
+void ps2_host_set_led(uint8_t led)
+{
+    ps2_host_send(PS2_SET_LED);
+    ps2_host_send(led);
+}
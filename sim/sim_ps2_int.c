@@ -0,0 +1,207 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Line level PS/2 keyboard for host simulation(make sim SIM_PS2_INT=yes)
+ * Interrupt driven ps2.c runs as it is: keyboard drives clock and data lines
+ * through PIN registers and calls clock ISR on each edge while it is enabled.
+ *
+ * Bytes put with sim_ps2_put() are sent when host doesn't inhibit, with
+ * sim_ps2_put_error() parity of the byte is broken. A byte inhibited in the
+ * middle is sent again. Bytes from host are printed and answered with ACK,
+ * RESEND(FE) is answered with the last byte and a byte with parity error
+ * with RESEND.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include "ps2.h"
+#include "sim.h"
+
+
+#define SIM_PS2_BUF_SIZE 256
+#define HALF_CLOCK_US   40
+#define PARITY_ERROR    0x100
+
+void PS2_INT_VECT(void);
+
+static uint16_t buf[SIM_PS2_BUF_SIZE];
+static uint8_t head = 0;
+static uint8_t tail = 0;
+static uint8_t last_sent = 0;
+static int16_t aborted = -1;
+static bool int_on = false;
+static bool dev_clock_lo = false;
+static bool dev_data_lo = false;
+
+
+static void put(uint16_t data)
+{
+    buf[head++] = data;
+    if (head == tail) {
+        fprintf(stderr, "sim ps2: buffer overflow\n");
+        tail++;
+    }
+}
+
+void sim_ps2_put(uint8_t data)
+{
+    put(data);
+}
+
+void sim_ps2_put_error(uint8_t data)
+{
+    put(data | PARITY_ERROR);
+}
+
+void sim_ps2_int_enable(bool on)
+{
+    int_on = on;
+}
+
+
+/* line is low when host or keyboard pulls it down */
+static bool host_clock_lo(void)
+{
+    return (PS2_CLOCK_DDR & (1<<PS2_CLOCK_BIT)) && !(PS2_CLOCK_PORT & (1<<PS2_CLOCK_BIT));
+}
+
+static bool host_data_lo(void)
+{
+    return (PS2_DATA_DDR & (1<<PS2_DATA_BIT)) && !(PS2_DATA_PORT & (1<<PS2_DATA_BIT));
+}
+
+static void lines(void)
+{
+    if (host_clock_lo() || dev_clock_lo)
+        PS2_CLOCK_PIN &= ~(1<<PS2_CLOCK_BIT);
+    else
+        PS2_CLOCK_PIN |= (1<<PS2_CLOCK_BIT);
+    if (host_data_lo() || dev_data_lo)
+        PS2_DATA_PIN &= ~(1<<PS2_DATA_BIT);
+    else
+        PS2_DATA_PIN |= (1<<PS2_DATA_BIT);
+}
+
+/* one clock pulse: ISR sees both edges like pin change interrupt */
+static void clock_pulse(void)
+{
+    dev_clock_lo = true;
+    lines();
+    if (int_on) PS2_INT_VECT();
+    sim_delay_us(HALF_CLOCK_US);
+
+    dev_clock_lo = false;
+    lines();
+    if (int_on) PS2_INT_VECT();
+    sim_delay_us(HALF_CLOCK_US);
+    lines();
+}
+
+/* keyboard to host: false when host inhibits in the middle */
+static bool send_frame(uint16_t data)
+{
+    uint8_t parity = 1;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (data & (1<<i)) parity ^= 1;
+    }
+    if (data & PARITY_ERROR) parity ^= 1;
+
+    // start, data LSB first, parity and stop
+    uint16_t frame = (1<<10) | (parity<<9) | ((data & 0xFF)<<1);
+    for (uint8_t i = 0; i < 11; i++) {
+        lines();
+        if (host_clock_lo()) {
+            dev_data_lo = false;
+            lines();
+            return false;
+        }
+        dev_data_lo = !(frame & (1<<i));
+        clock_pulse();
+    }
+    dev_data_lo = false;
+    lines();
+    return true;
+}
+
+/* byte inhibited is kept to send again without error */
+static void transmit(uint16_t data)
+{
+    if (send_frame(data))
+        last_sent = data & 0xFF;
+    else
+        aborted = data & 0xFF;
+}
+
+/* host to keyboard: host has released clock with data low(request to send) */
+static void recv_frame(void)
+{
+    uint16_t frame = 0;
+    uint8_t parity = 0;
+
+    // data, parity and stop are put by host on falling edge
+    for (uint8_t i = 0; i < 10; i++) {
+        clock_pulse();
+        if (PS2_DATA_PIN & (1<<PS2_DATA_BIT)) {
+            frame |= (1<<i);
+            if (i < 9) parity ^= 1;
+        }
+    }
+    // ack
+    dev_data_lo = true;
+    clock_pulse();
+    dev_data_lo = false;
+    lines();
+
+    uint8_t data = frame & 0xFF;
+    printf("%7u.%03u ps2 send %02X\n", sim_time_us() / 1000, sim_time_us() % 1000, data);
+    if (!parity || !(frame & (1<<9))) {
+        // parity or stop bit error
+        transmit(PS2_RESEND);
+    } else if (data == PS2_RESEND) {
+        if (aborted >= 0) {
+            data = aborted;
+            aborted = -1;
+        } else {
+            data = last_sent;
+        }
+        transmit(data);
+    } else {
+        transmit(PS2_ACK);
+    }
+}
+
+/* called every scan */
+void sim_ps2_task(void)
+{
+    lines();
+    if (host_clock_lo())
+        return;
+
+    if (host_data_lo()) {
+        recv_frame();
+        return;
+    }
+    if (aborted >= 0) {
+        uint8_t data = aborted;
+        aborted = -1;
+        transmit(data);
+    } else if (head != tail) {
+        transmit(buf[tail++]);
+    }
+}
@@ -0,0 +1,34 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Clock interrupt of ps2.c for host simulation(make sim SIM_PS2_INT=yes)
+ * Included after config.h, ISR is called by keyboard in sim_ps2_int.c.
+ */
+#ifndef SIM_PS2_INT_H
+#define SIM_PS2_INT_H
+
+#include <stdbool.h>
+
+
+#define PS2_INT_VECT        sim_ps2_int_vect
+#define PS2_INT_ENABLE()    sim_ps2_int_enable(true)
+#define PS2_INT_DISABLE()   sim_ps2_int_enable(false)
+
+void sim_ps2_int_enable(bool on);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Host test of debounce.c
+ * Built for each DEBOUNCE and DEBOUNCE_TYPE by 'make sim_test', scans every
+ * 1ms of simulated clock and checks that cooked rows follow raw rows.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+#include "sim.h"
+
+
+bool debug_enable = false;
+
+static matrix_row_t raw[MATRIX_ROWS];
+static matrix_row_t cooked[MATRIX_ROWS];
+static int fails = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        printf("FAIL: %s: %s at %ums\n", msg, #cond, sim_time_us() / 1000); \
+        fails++; \
+    } \
+} while (0)
+
+
+static bool same(void)
+{
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        if (raw[i] != cooked[i]) return false;
+    }
+    return true;
+}
+
+/* one scan: return value of debounce() should tell change of cooked */
+static void scan(const char *msg)
+{
+    matrix_row_t prev[MATRIX_ROWS];
+    bool modified = false;
+
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) prev[i] = cooked[i];
+    sim_delay_us(1000);
+    bool changed = debounce(raw, cooked);
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        if (prev[i] != cooked[i]) modified = true;
+    }
+    CHECK(changed == modified, msg);
+#if (DEBOUNCE == 0)
+    CHECK(same(), msg);
+#endif
+}
+
+/* raw stays as it is: cooked should catch up in DEBOUNCE and stay */
+static void hold(const char *msg)
+{
+    for (uint8_t i = 0; i <= DEBOUNCE; i++) scan(msg);
+    CHECK(same(), msg);
+    for (uint8_t i = 0; i <= DEBOUNCE; i++) scan(msg);
+    CHECK(same(), msg);
+}
+
+int main(void)
+{
+    debounce_init();
+
+    raw[0] = 0x01;
+    hold("press");
+    raw[0] = 0x00;
+    hold("release");
+
+    // changes of same key after it is reported
+    for (uint8_t i = 0; i < 4; i++) {
+        raw[1] ^= 0x80;
+        hold("repeat");
+    }
+
+    // chatter settles to pressed
+    for (uint8_t i = 0; i < 9; i++) {
+        raw[MATRIX_ROWS - 1] ^= 0x10;
+        scan("chatter");
+    }
+    hold("chatter");
+
+    // keys on several rows at once
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) raw[i] = 0x5A;
+    hold("rows");
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) raw[i] = 0x00;
+    hold("rows");
+
+    printf("debounce DEBOUNCE=%d DEBOUNCE_TYPE=%d: %s\n",
+            DEBOUNCE, DEBOUNCE_TYPE, fails ? "FAIL" : "ok");
+    return fails ? 1 : 0;
+}
@@ -59,6 +59,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
         UBRR1H = (uint8_t) (NEWS_KBD_RX_UBBR>>8); \
         UCSR1B |= (1<<RXCIE1) | (1<<RXEN1); \
     } while(0)
+/* TxD(PD3) to keyboard for LED
+ * NOTE: LED command format is not confirmed yet(see news.c), uncomment to try */
+/*
+#   define NEWS_KBD_TX_VECT        USART1_UDRE_vect
+#   define NEWS_KBD_TX_DATA        UDR1
+#   define NEWS_KBD_TX_INIT()      do { \
+        UCSR1B |= (1<<TXEN1); \
+    } while(0)
+#   define NEWS_KBD_TX_INT_ON()    do { \
+        UCSR1B |= (1<<UDRIE1); \
+    } while(0)
+#   define NEWS_KBD_TX_INT_OFF()   do { \
+        UCSR1B &= ~(1<<UDRIE1); \
+    } while(0)
+*/
 #else
 #   error "USART configuration is needed."
 #endif
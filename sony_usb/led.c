@@ -22,5 +22,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 void led_set(uint8_t usb_led)
 {
-    // not supported now
+#ifdef NEWS_KBD_TX_VECT
+    uint8_t led = NEWS_LED_CMD;
+    if (usb_led & (1<<USB_LED_CAPS_LOCK)) led |= NEWS_LED_CAPS;
+    if (usb_led & (1<<USB_LED_KANA))      led |= NEWS_LED_KANA;
+    news_send(led);
+#endif
 }
@@ -38,41 +38,57 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include "ring.h"
 #include "news.h"
 
 
 void news_init(void)
 {
     NEWS_KBD_RX_INIT();
+#ifdef NEWS_KBD_TX_VECT
+    NEWS_KBD_TX_INIT();
+#endif
 }
 
 // RX ring buffer
-#define RBUF_SIZE   8
-static uint8_t rbuf[RBUF_SIZE];
-static uint8_t rbuf_head = 0;
-static uint8_t rbuf_tail = 0;
+static volatile ring_stat_t rbuf_stat;
+RING_DEFINE(rbuf, 8, rbuf_stat)
 
 uint8_t news_recv(void)
 {
-    uint8_t data = 0;
-    if (rbuf_head == rbuf_tail) {
-        return 0;
-    }
-
-    data = rbuf[rbuf_tail];
-    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
-    return data;
+    return rbuf_get();
 }
 
 // USART RX complete interrupt
 ISR(NEWS_KBD_RX_VECT)
 {
-    uint8_t next = (rbuf_head + 1) % RBUF_SIZE;
-    if (next != rbuf_tail) {
-        rbuf[rbuf_head] = NEWS_KBD_RX_DATA;
-        rbuf_head = next;
+    rbuf_put(NEWS_KBD_RX_DATA);
+}
+
+#ifdef NEWS_KBD_TX_VECT
+// TX ring buffer
+static volatile ring_stat_t tbuf_stat;
+RING_DEFINE(tbuf, 8, tbuf_stat)
+
+/* queue a byte to send, returns false when queue is full. never waits */
+bool news_send(uint8_t data)
+{
+    if (!tbuf_put(data))
+        return false;
+    NEWS_KBD_TX_INT_ON();
+    return true;
+}
+
+// USART data register empty interrupt
+ISR(NEWS_KBD_TX_VECT)
+{
+    if (tbuf_empty()) {
+        NEWS_KBD_TX_INT_OFF();
+    } else {
+        NEWS_KBD_TX_DATA = tbuf_get();
     }
 }
+#endif
 
 
 /*
@@ -122,6 +138,10 @@ Pinouts
     9 GND
     NOTE: These are just from my guess and not confirmed.
 
+    Keyboard RxD(pin 6 of NWP-5461) is driven by converter TxD with same
+    signaling as keyboard data. LED command is also a guess and not confirmed:
+    bit 7 is 1 and bit 0/1 turn on CAPS/KANA LED.
+
 
 Signaling
 ---------
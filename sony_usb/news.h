@@ -42,9 +42,18 @@ POSSIBILITY OF SUCH DAMAGE.
  */
 
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NEWS_LED_CMD    0x80
+#define NEWS_LED_CAPS   0x01
+#define NEWS_LED_KANA   0x02
+
 /* host role */
 void news_init(void);
 uint8_t news_recv(void);
+/* interrupt driven transmit(NEWS_KBD_TX_VECT) */
+bool news_send(uint8_t data);
 
 /* device role */
 
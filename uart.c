@@ -30,18 +30,17 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
+#include "ring.h"
 #include "uart.h"
 
-// These buffers may be any size from 2 to 256 bytes.
+// These buffers may be any power of 2 size from 2 to 256 bytes.
 #define RX_BUFFER_SIZE 64
-#define TX_BUFFER_SIZE 40
+#define TX_BUFFER_SIZE 32
 
-static volatile uint8_t tx_buffer[TX_BUFFER_SIZE];
-static volatile uint8_t tx_buffer_head;
-static volatile uint8_t tx_buffer_tail;
-static volatile uint8_t rx_buffer[RX_BUFFER_SIZE];
-static volatile uint8_t rx_buffer_head;
-static volatile uint8_t rx_buffer_tail;
+static volatile ring_stat_t tx_stat;
+static volatile ring_stat_t rx_stat;
+RING_DEFINE(tx_buffer, TX_BUFFER_SIZE, tx_stat)
+RING_DEFINE(rx_buffer, RX_BUFFER_SIZE, rx_stat)
 
 // Initialize the UART
 void uart_init(uint32_t baud)
@@ -51,37 +50,24 @@ void uart_init(uint32_t baud)
 	UCSR0A = (1<<U2X0);
 	UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0);
 	UCSR0C = (1<<UCSZ01) | (1<<UCSZ00);
-	tx_buffer_head = tx_buffer_tail = 0;
-	rx_buffer_head = rx_buffer_tail = 0;
+	tx_buffer_clear();
+	rx_buffer_clear();
 	sei();
 }
 
 // Transmit a byte
 void uart_putchar(uint8_t c)
 {
-	uint8_t i;
-
-	i = tx_buffer_head + 1;
-	if (i >= TX_BUFFER_SIZE) i = 0;
-	while (tx_buffer_tail == i) ; // wait until space in buffer
-	//cli();
-	tx_buffer[i] = c;
-	tx_buffer_head = i;
+	while (tx_buffer_full()) ; // wait until space in buffer
+	tx_buffer_put(c);
 	UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0) | (1<<UDRIE0);
-	//sei();
 }
 
 // Receive a byte
 uint8_t uart_getchar(void)
 {
-        uint8_t c, i;
-
-	while (rx_buffer_head == rx_buffer_tail) ; // wait for character
-        i = rx_buffer_tail + 1;
-        if (i >= RX_BUFFER_SIZE) i = 0;
-        c = rx_buffer[i];
-        rx_buffer_tail = i;
-        return c;
+	while (rx_buffer_empty()) ; // wait for character
+	return rx_buffer_get();
 }
 
 // Return the number of bytes waiting in the receive buffer.
@@ -89,41 +75,23 @@ uint8_t uart_getchar(void)
 // to wait for a byte to arrive.
 uint8_t uart_available(void)
 {
-	uint8_t head, tail;
-
-	head = rx_buffer_head;
-	tail = rx_buffer_tail;
-	if (head >= tail) return head - tail;
-	return RX_BUFFER_SIZE + head - tail;
+	return rx_buffer_count();
 }
 
 // Transmit Interrupt
 ISR(USART_UDRE_vect)
 {
-	uint8_t i;
-
-	if (tx_buffer_head == tx_buffer_tail) {
+	if (tx_buffer_empty()) {
 		// buffer is empty, disable transmit interrupt
 		UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0);
 	} else {
-		i = tx_buffer_tail + 1;
-		if (i >= TX_BUFFER_SIZE) i = 0;
-		UDR0 = tx_buffer[i];
-		tx_buffer_tail = i;
+		UDR0 = tx_buffer_get();
 	}
 }
 
 // Receive Interrupt
 ISR(USART_RX_vect)
 {
-	uint8_t c, i;
-
-	c = UDR0;
-	i = rx_buffer_head + 1;
-	if (i >= RX_BUFFER_SIZE) i = 0;
-	if (i != rx_buffer_tail) {
-		rx_buffer[i] = c;
-		rx_buffer_head = i;
-	}
+	rx_buffer_put(UDR0);
 }
 
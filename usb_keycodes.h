@@ -27,6 +27,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define IS_KEY(code)             (KB_A         <= (code) && (code) <= KB_EXSEL)
 #define IS_MOD(code)             (KB_LCTRL     <= (code) && (code) <= KB_RGUI)
 #define IS_FN(code)              (KB_FN0       <= (code) && (code) <= KB_FN7)
+#define IS_SYSTEM(code)          (KB_SYSTEM_POWER <= (code) && (code) <= KB_SYSTEM_WAKE)
+#define IS_CONSUMER(code)        (KB_AUDIO_MUTE   <= (code) && (code) <= KB_WWW_FAVORITES)
 #define IS_MOUSEKEY(code)        (KB_MS_UP     <= (code) && (code) <= KB_MS_WH_RIGHT)
 #define IS_MOUSEKEY_MOVE(code)   (KB_MS_UP     <= (code) && (code) <= KB_MS_RIGHT)
 #define IS_MOUSEKEY_BUTTON(code) (KB_MS_BTN1   <= (code) && (code) <= KB_MS_BTN5)
@@ -110,6 +112,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define KB_WH_D KB_MS_WH_DOWN
 #define KB_WH_L KB_MS_WH_LEFT
 #define KB_WH_R KB_MS_WH_RIGHT
+/* Layer */
+#define KB_TRNS KB_TRANSPARENT
 /* Sytem Control & Consumer usage */
 #define KB_PWR  KB_SYSTEM_POWER
 #define KB_SLEP KB_SYSTEM_SLEEP
@@ -136,6 +140,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 /* Special keycode */
 enum special_keycodes {
+    /* Transparent: use keycode of lower layer */
+    KB_TRANSPARENT = 0xAF,
+
     /* System Control */
     KB_SYSTEM_POWER = 0xB0,
     KB_SYSTEM_SLEEP,
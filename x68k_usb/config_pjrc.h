@@ -48,6 +48,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 /* USART configuration
  *     asynchronous, 2400baud, 8-data bit, non parity, 1-stop bit, no flow control
+ *     RX and TX share baud rate setting
  */
 #ifdef __AVR_ATmega32U4__
 #   define KBD_RX_VECT        USART1_RX_vect
@@ -59,6 +60,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
         UBRR1H = (uint8_t) (KBD_RX_UBBR>>8); \
         UCSR1B |= (1<<RXCIE1) | (1<<RXEN1); \
     } while(0)
+/* TxD(PD3) to keyboard for LED and repeat, comment out if not wired */
+#   define KBD_TX_VECT        USART1_UDRE_vect
+#   define KBD_TX_DATA        UDR1
+#   define KBD_TX_INIT()      do { \
+        UCSR1B |= (1<<TXEN1); \
+    } while(0)
+#   define KBD_TX_INT_ON()    do { \
+        UCSR1B |= (1<<UDRIE1); \
+    } while(0)
+#   define KBD_TX_INT_OFF()   do { \
+        UCSR1B &= ~(1<<UDRIE1); \
+    } while(0)
 #else
 #   error "USART configuration is needed."
 #endif
@@ -22,5 +22,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 void led_set(uint8_t usb_led)
 {
-    // not supported now
+#ifdef KBD_TX_VECT
+    // LED is on with 0
+    uint8_t led = 0x7F;
+    if (usb_led & (1<<USB_LED_CAPS_LOCK)) led &= ~X68K_LED_CAPS;
+    if (usb_led & (1<<USB_LED_KANA))      led &= ~X68K_LED_KANA;
+    x68k_send(X68K_LED | led);
+#endif
 }
@@ -38,38 +38,57 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include "ring.h"
 #include "x68k.h"
 
 
 void x68k_init(void)
 {
     KBD_RX_INIT();
+#ifdef KBD_TX_VECT
+    KBD_TX_INIT();
+    // host does key repeat: make keyboard repeat as slow as possible
+    x68k_send(X68K_REPEAT_DELAY | 0x0F);
+    x68k_send(X68K_REPEAT_TIME | 0x0F);
+#endif
 }
 
 // RX ring buffer
-#define RBUF_SIZE   8
-static uint8_t rbuf[RBUF_SIZE];
-static uint8_t rbuf_head = 0;
-static uint8_t rbuf_tail = 0;
+static volatile ring_stat_t rbuf_stat;
+RING_DEFINE(rbuf, 8, rbuf_stat)
 
 uint8_t x68k_recv(void)
 {
-    uint8_t data = 0;
-    if (rbuf_head == rbuf_tail) {
-        return 0;
-    }
-
-    data = rbuf[rbuf_tail];
-    rbuf_tail = (rbuf_tail + 1) % RBUF_SIZE;
-    return data;
+    return rbuf_get();
 }
 
 // USART RX complete interrupt
 ISR(KBD_RX_VECT)
 {
-    uint8_t next = (rbuf_head + 1) % RBUF_SIZE;
-    if (next != rbuf_tail) {
-        rbuf[rbuf_head] = KBD_RX_DATA;
-        rbuf_head = next;
+    rbuf_put(KBD_RX_DATA);
+}
+
+#ifdef KBD_TX_VECT
+// TX ring buffer
+static volatile ring_stat_t tbuf_stat;
+RING_DEFINE(tbuf, 8, tbuf_stat)
+
+/* queue a byte to send, returns false when queue is full. never waits */
+bool x68k_send(uint8_t data)
+{
+    if (!tbuf_put(data))
+        return false;
+    KBD_TX_INT_ON();
+    return true;
+}
+
+// USART data register empty interrupt
+ISR(KBD_TX_VECT)
+{
+    if (tbuf_empty()) {
+        KBD_TX_INT_OFF();
+    } else {
+        KBD_TX_DATA = tbuf_get();
     }
 }
+#endif
@@ -38,9 +38,27 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef X68K_H
 #define X68K_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+/* commands from computer: see README */
+#define X68K_LED            0x80    // bit 6-0: LED off(1)/on(0)
+#define X68K_LED_KANA       0x01
+#define X68K_LED_ROMAJI     0x02
+#define X68K_LED_CODE       0x04
+#define X68K_LED_CAPS       0x08
+#define X68K_LED_INS        0x10
+#define X68K_LED_HIRAGANA   0x20
+#define X68K_LED_ZENKAKU    0x40
+#define X68K_MSCTRL         0x40    // bit 0: mouse enable
+#define X68K_REPEAT_DELAY   0x60    // bit 3-0: 200+delay*100 ms
+#define X68K_REPEAT_TIME    0x70    // bit 3-0: 30+time^2*5 ms
+
 /* host role */
 void x68k_init(void);
 uint8_t x68k_recv(void);
+/* interrupt driven transmit(KBD_TX_VECT) */
+bool x68k_send(uint8_t data);
 
 /* device role */
 